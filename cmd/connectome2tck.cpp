@@ -13,6 +13,7 @@
  */
 
 
+#include <algorithm>
 #include <sstream>
 #include <string>
 
@@ -25,6 +26,7 @@
 #include "connectome/connectome.h"
 
 #include "dwi/tractography/file.h"
+#include "dwi/tractography/index.h"
 #include "dwi/tractography/properties.h"
 #include "dwi/tractography/weights.h"
 #include "dwi/tractography/connectome/extract.h"
@@ -107,6 +109,38 @@ void usage ()
 
 
 
+// Pass the streamlines to the writer in order; if the track file has an offset
+//   index, only those streamlines flagged as needed are actually read from file,
+//   the remainder being passed without their vertices (so they can only be skipped)
+template <class StreamlineType, class AssignmentType>
+void extract (Tractography::Reader<float>& reader, const Tractography::Index& index, const vector<bool>& needed,
+              const vector<AssignmentType>& assignments, WriterExtraction& writer)
+{
+  StreamlineType tck;
+  ProgressBar progress ("Extracting tracks from connectome", assignments.size());
+  if (index.size()) {
+    for (size_t n = 0; n != assignments.size(); ++n) {
+      if (needed[n]) {
+        reader.read (index, n, tck);
+      } else {
+        tck.clear();
+        tck.index = n;
+      }
+      tck.set_nodes (assignments[n]);
+      writer (tck);
+      ++progress;
+    }
+  } else {
+    while (reader (tck)) {
+      tck.set_nodes (assignments[tck.index]);
+      writer (tck);
+      ++progress;
+    }
+  }
+}
+
+
+
 void run ()
 {
 
@@ -325,23 +359,29 @@ void run ()
         break;
     }
 
-    ProgressBar progress ("Extracting tracks from connectome", count);
-    if (assignments_pairs.size()) {
-      Tractography::Connectome::Streamline_nodepair tck;
-      while (reader (tck)) {
-        tck.set_nodes (assignments_pairs[tck.index]);
-        writer (tck);
-        ++progress;
-      }
-    } else {
-      Tractography::Connectome::Streamline_nodelist tck;
-      while (reader (tck)) {
-        tck.set_nodes (assignments_lists[tck.index]);
-        writer (tck);
-        ++progress;
+    // If only a subset of nodes is of interest, the offset index of the track file
+    //   (if available) allows reading only those streamlines that involve them
+    Tractography::Index index;
+    vector<bool> needed;
+    if (manual_node_list && index.load (argument[0])) {
+      if (index.size() != count)
+        throw Exception ("Offset index of track file lists " + str(index.size()) + " tracks; track file contains " + str(count) + " tracks");
+      auto involved = [&] (const node_t node) { return std::binary_search (nodes.begin(), nodes.end(), node); };
+      needed.reserve (count);
+      for (size_t n = 0; n != count; ++n) {
+        if (assignments_pairs.size())
+          needed.push_back (involved (assignments_pairs[n].first) || involved (assignments_pairs[n].second));
+        else
+          needed.push_back (std::any_of (assignments_lists[n].begin(), assignments_lists[n].end(), involved));
       }
+      INFO ("Using offset index of track file to read only the " + str(std::count (needed.begin(), needed.end(), true)) + " tracks involving nodes of interest");
     }
 
+    if (assignments_pairs.size())
+      extract<Tractography::Connectome::Streamline_nodepair> (reader, index, needed, assignments_pairs, writer);
+    else
+      extract<Tractography::Connectome::Streamline_nodelist> (reader, index, needed, assignments_lists, writer);
+
   }
 
 }
@@ -14,6 +14,7 @@
 
 
 #include "command.h"
+#include "memory_usage.h"
 #include "progressbar.h"
 #include "types.h"
 
@@ -207,6 +208,7 @@ void run()
   MR::Connectome::Mat2Vec mat2vec (num_nodes);
   const size_t num_edges = mat2vec.vec_size();
   matrix_type data (num_edges, filenames.size());
+  const auto data_memory = MemoryUsage::track (data);
   {
     ProgressBar progress ("Loading input connectome data", filenames.size());
     for (size_t subject = 0; subject < filenames.size(); subject++) {
@@ -16,6 +16,7 @@
 #include "command.h"
 #include "header.h"
 #include "image.h"
+#include "image_span.h"
 #include "phase_encoding.h"
 #include "algo/threaded_loop.h"
 #include "dwi/gradient.h"
@@ -108,10 +109,9 @@ class CSD_Processor { MEMALIGN(CSD_Processor)
       mask (mask) { }
 
 
-    void operator () (Image<float>& dwi, Image<float>& fod) {
+    void operator () (const ImageSpan<float>& dwi, ImageSpan<float>& fod) {
       if (!load_data (dwi)) {
-        for (auto l = Loop (3) (fod); l; ++l)
-          fod.value() = 0.0;
+        fod.array().setZero();
         return;
       }
 
@@ -123,7 +123,7 @@ class CSD_Processor { MEMALIGN(CSD_Processor)
           break;
 
       if (sdeconv.shared.niter && n >= sdeconv.shared.niter)
-        INFO ("voxel [ " + str (dwi.index(0)) + " " + str (dwi.index(1)) + " " + str (dwi.index(2)) +
+        INFO ("voxel [ " + str (dwi.parent().index(0)) + " " + str (dwi.parent().index(1)) + " " + str (dwi.parent().index(2)) +
             " ] did not reach full convergence");
 
       write_back (fod);
@@ -136,16 +136,15 @@ class CSD_Processor { MEMALIGN(CSD_Processor)
     Image<bool> mask;
 
 
-    bool load_data (Image<float>& dwi) {
+    bool load_data (const ImageSpan<float>& dwi) {
       if (mask.valid()) {
-        assign_pos_of (dwi, 0, 3).to (mask);
+        assign_pos_of (dwi.parent(), 0, 3).to (mask);
         if (!mask.value())
           return false;
       }
 
       for (size_t n = 0; n < sdeconv.shared.dwis.size(); n++) {
-        dwi.index(3) = sdeconv.shared.dwis[n];
-        data[n] = dwi.value();
+        data[n] = dwi[sdeconv.shared.dwis[n]];
         if (!std::isfinite (data[n]))
           return false;
         if (data[n] < 0.0)
@@ -156,9 +155,8 @@ class CSD_Processor { MEMALIGN(CSD_Processor)
     }
 
 
-    void write_back (Image<float>& fod) {
-      for (auto l = Loop (3) (fod); l; ++l)
-        fod.value() = sdeconv.FOD() [fod.index(3)];
+    void write_back (ImageSpan<float>& fod) {
+      fod.matrix() = sdeconv.FOD().cast<float>();
     }
 
 };
@@ -255,9 +253,9 @@ void run ()
     auto fod = Image<float>::create (argument[3], header_out);
 
     CSD_Processor processor (shared, mask);
-    auto dwi = header_in.get_image<float>().with_direct_io (3);
-    ThreadedLoop ("performing constrained spherical deconvolution", dwi, 0, 3)
-        .run (processor, dwi, fod);
+    const auto dwi = header_in.get_image<float>().with_direct_io (3);
+    ThreadedLoop ("performing constrained spherical deconvolution", dwi, { 3, 0, 1, 2 }, 1)
+        .run_span (processor, dwi, write_only (fod));
 
   } else if (algorithm == 1) {
 
@@ -53,11 +53,10 @@ void usage ()
 void run()
 {
   auto input_header = Header::open (argument[0]);
-  auto input_image = input_header.get_image<float>();
 
-  Eigen::MatrixXd grad_unprocessed = DWI::get_DW_scheme (input_image);
+  Eigen::MatrixXd grad_unprocessed = DWI::get_DW_scheme (input_header);
   Eigen::MatrixXd grad = grad_unprocessed;
-  DWI::validate_DW_scheme (grad, input_image);
+  DWI::validate_DW_scheme (grad, input_header);
 
   // Want to support non-shell-like data if it's just a straight extraction
   //   of all dwis or all bzeros i.e. don't initialise the Shells class
@@ -122,6 +121,10 @@ void run()
 
   std::sort (volumes.begin(), volumes.end());
 
+  input_header.set_access_indices (3, volumes);
+  input_header.set_streaming();
+  auto input_image = input_header.get_image<float>();
+
   Header header (input_image);
   Stride::set_from_command_line (header);
   header.size (3) = volumes.size();
@@ -142,5 +145,12 @@ void run()
   DWI::export_grad_commandline (header);
 
   auto input_volumes = Adapter::make<Adapter::Extract1D> (input_image, 3, volumes);
-  threaded_copy_with_progress_message ("extracting volumes", input_volumes, output_image);
+  if ((input_image.is_streamed() || output_image.is_streamed()) && input_image.ndim() == 4) {
+    threaded_copy_volumes_with_progress_message ("extracting volumes", input_volumes, output_image,
+        [&] (size_t n) { input_image.wait_for_volumes (volumes[n] + 1); });
+  }
+  else {
+    input_image.wait_for_volumes (volumes.back() + 1);
+    threaded_copy_with_progress_message ("extracting volumes", input_volumes, output_image);
+  }
 }
@@ -14,6 +14,7 @@
 
 
 #include "command.h"
+#include "memory_usage.h"
 #include "progressbar.h"
 #include "thread_queue.h"
 #include "algo/loop.h"
@@ -121,7 +122,9 @@ void usage ()
   + Argument ("value").type_float (0.0, 90.0)
 
   + Option ("mask", "provide a fixel data file containing a mask of those fixels to be used during processing")
-  + Argument ("file").type_image_in();
+  + Argument ("file").type_image_in()
+
+  + Thread::AffinityOption;
 
 }
 
@@ -296,7 +299,7 @@ void run() {
     mapper.set_use_precise_mapping (true);
     Stats::CFE::TrackProcessor tract_processor (index_image, directions, mask, fixel_TDI, connectivity_matrix, angular_threshold);
     Thread::run_queue (
-        loader,
+        Thread::multi (loader, loader.num_threads()),
         Thread::batch (DWI::Tractography::Streamline<float>()),
         mapper,
         Thread::batch (DWI::Tractography::Mapping::SetVoxelDir()),
@@ -399,6 +402,7 @@ void run() {
 
   // Load input data
   matrix_type data (mask_fixels, identifiers.size());
+  const auto data_memory = MemoryUsage::track (data);
   data.setZero();
   {
     ProgressBar progress (std::string ("loading input images") + (do_smoothing ? " and smoothing" : ""), identifiers.size());
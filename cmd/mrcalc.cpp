@@ -239,6 +239,9 @@ class StackEntry { NOMEMALIGN
         try {
           auto header = Header::open (arg);
           image_is_complex = header.datatype().is_complex();
+          // streamed volumes are waited for in run_operations():
+          header.set_streaming();
+          header.set_access_pattern (File::MMap::Access::Sequential);
           image.reset (new Image<complex_type> (header.get_image<complex_type>()));
           image_list.insert (std::make_pair (arg, LoadedImage (image, image_is_complex)));
         }
@@ -728,6 +731,35 @@ void run_operations (const vector<StackEntry>& stack)
 
   auto output = Header::create (stack[1].arg, header).get_image<complex_type>();
 
+  bool streamed = output.is_streamed();
+  for (const auto& entry : StackEntry::image_list)
+    streamed |= entry.second.image->is_streamed();
+
+  if (streamed && output.ndim() == 4) {
+    // process one volume at a time, as each becomes available:
+    auto loop = ThreadedLoop (output, 0, 3, 2);
+    ThreadFunctor functor (loop.inner_axes, stack[0], output);
+    ProgressBar progress ("computing: " + operation_string(stack[0]), output.size (3));
+    for (ssize_t n = 0; n < output.size (3); ++n) {
+      for (const auto& entry : StackEntry::image_list) {
+        const auto& image (*entry.second.image);
+        if (image.ndim() == 4)
+          image.wait_for_volumes (image.size (3) > 1 ? n+1 : 1);
+      }
+      loop.iterator.index (3) = n;
+      loop.run_outer (functor);
+      output.publish_volumes (n+1);
+      ++progress;
+    }
+    return;
+  }
+
+  for (const auto& entry : StackEntry::image_list) {
+    const auto& image (*entry.second.image);
+    if (image.ndim() == 4)
+      image.wait_for_volumes (image.size (3));
+  }
+
   auto loop = ThreadedLoop ("computing: " + operation_string(stack[0]), output, 0, output.ndim(), 2);
 
   ThreadFunctor functor (loop.inner_axes, stack[0], output);
@@ -1159,7 +1191,7 @@ void run () {
       else if (opt->is ("replace")) ternary_operation (opt->id, stack, OpReplace());
 
       else if (opt->is ("datatype")) ++n;
-      else if (opt->is ("nthreads")) ++n;
+      else if (opt->is ("nthreads") || opt->is ("profile")) ++n;
       else if (opt->is ("force") || opt->is ("info") || opt->is ("debug") || opt->is ("quiet"))
         continue;
 
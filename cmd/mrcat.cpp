@@ -63,6 +63,7 @@ void write (vector<Header>& in,
   size_t axis_offset = 0;
 
   for (size_t i = 0; i != in.size(); i++) {
+    in[i].set_streaming();
     auto image_in = in[i].get_image<value_type>();
 
     auto copy_func = [&axis, &axis_offset](decltype(image_in)& in, decltype(image_out)& out)
@@ -71,8 +72,26 @@ void write (vector<Header>& in,
       out.value() = in.value();
     };
 
-    ThreadedLoop ("concatenating \"" + image_in.name() + "\"", image_in, 0, std::min<size_t> (image_in.ndim(), image_out.ndim()))
-      .run (copy_func, image_in, image_out);
+    const size_t num_volumes = image_in.ndim() > 3 ? image_in.size (3) : 1;
+    if ((image_in.is_streamed() || image_out.is_streamed()) && axis == 3 && image_out.ndim() == 4) {
+      // concatenating volumes: process each volume as soon as it is available
+      ProgressBar progress ("concatenating \"" + image_in.name() + "\"", num_volumes);
+      for (size_t n = 0; n < num_volumes; ++n) {
+        image_in.wait_for_volumes (n+1);
+        if (image_in.ndim() > 3)
+          image_in.index (3) = n;
+        ThreadedLoop (image_in, 0, 3).run (copy_func, image_in, image_out);
+        image_out.publish_volumes (axis_offset + n + 1);
+        ++progress;
+      }
+    }
+    else {
+      image_in.wait_for_volumes (num_volumes);
+      ThreadedLoop ("concatenating \"" + image_in.name() + "\"", image_in, 0, std::min<size_t> (image_in.ndim(), image_out.ndim()))
+        .run (copy_func, image_in, image_out);
+      if (axis == 3)
+        image_out.publish_volumes (axis_offset + num_volumes);
+    }
     if (axis < image_in.ndim())
       axis_offset += image_in.size (axis);
     else {
@@ -14,6 +14,7 @@
 
 
 #include "command.h"
+#include "memory_usage.h"
 #include "file/path.h"
 #include "algo/loop.h"
 #include "image.h"
@@ -168,6 +169,7 @@ void run() {
   const size_t num_vox = mask_indices.size();
 
   matrix_type data (num_vox, subjects.size());
+  const auto data_memory = MemoryUsage::track (data);
 
   {
     // Load images
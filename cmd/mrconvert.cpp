@@ -277,15 +277,57 @@ inline vector<int> set_header (Header& header, const ImageType& input)
 
 
 
+// whether the positions in pos select a single contiguous range of
+// positions along at most one axis, in which case first is set to the start
+// of that range:
+bool is_contiguous_range (const Header& header, const vector<vector<int>>& pos, ssize_t& first)
+{
+  first = 0;
+  bool found = false;
+  for (size_t axis = 0; axis < pos.size(); ++axis) {
+    if (pos[axis].empty())
+      continue;
+    for (size_t n = 1; n < pos[axis].size(); ++n)
+      if (pos[axis][n] != pos[axis][n-1] + 1)
+        return false;
+    if (pos[axis].front() == 0 && ssize_t (pos[axis].size()) == header.size (axis))
+      continue;
+    if (found)
+      return false;
+    found = true;
+    first = pos[axis].front();
+  }
+  return true;
+}
+
+
+
 template <typename T, class InputType>
-void copy_permute (const InputType& in, Header& header_out, const std::string& output_filename)
+void copy_permute (Image<T>& source, const InputType& in, Header& header_out, const std::string& output_filename, const vector<vector<int>>& pos)
 {
+  const vector<int> volumes = pos.size() > 3 ? pos[3] : vector<int>();
   const auto axes = set_header (header_out, in);
   auto out = Image<T>::create (output_filename, header_out);
   DWI::export_grad_commandline (out);
   PhaseEncoding::export_commandline (out);
   auto perm = Adapter::make <Adapter::PermuteAxes> (in, axes);
-  threaded_copy_with_progress (perm, out, 0, std::numeric_limits<size_t>::max(), 2);
+  if ((source.is_streamed() || out.is_streamed()) && source.ndim() == 4 && axes.size() == 4 && axes[3] == 3) {
+    threaded_copy_volumes_with_progress_message ("copying from \"" + shorten (perm.name()) + "\" to \"" + shorten (out.name()) + "\"",
+        perm, out, [&] (size_t n) { source.wait_for_volumes ((volumes.empty() ? n : volumes[n]) + 1); });
+  }
+  else {
+    if (source.ndim() == 4)
+      source.wait_for_volumes (source.size (3));
+    // copy the raw data directly if the layouts match:
+    bool is_identity = axes.size() == source.ndim();
+    for (size_t n = 0; n < axes.size(); ++n)
+      is_identity &= axes[n] == int (n);
+    ssize_t first;
+    if (is_identity && is_contiguous_range (source, pos, first) &&
+        raw_copy_with_progress_message ("copying from \"" + shorten (perm.name()) + "\" to \"" + shorten (out.name()) + "\"", source, out, first))
+      return;
+    threaded_copy_with_progress (perm, out, 0, std::numeric_limits<size_t>::max(), 2);
+  }
 }
 
 
@@ -296,12 +338,15 @@ void copy_permute (const InputType& in, Header& header_out, const std::string& o
 template <typename T>
 void extract (Header& header_in, Header& header_out, const vector<vector<int>>& pos, const std::string& output_filename)
 {
+  // input volumes are waited for in copy_permute() if streamed:
+  header_in.set_streaming();
+  header_in.set_access_pattern (File::MMap::Access::Sequential);
   auto in = header_in.get_image<T>();
   if (pos.empty()) {
-    copy_permute<T, decltype(in)> (in, header_out, output_filename);
+    copy_permute<T, decltype(in)> (in, in, header_out, output_filename, pos);
   } else {
     auto extract = Adapter::make<Adapter::Extract> (in, pos);
-    copy_permute<T, decltype(extract)> (extract, header_out, output_filename);
+    copy_permute<T, decltype(extract)> (in, extract, header_out, output_filename, pos);
   }
 }
 
@@ -377,6 +422,7 @@ void run ()
         throw Exception ("coordinate position " + str(*maxval) + " for axis " + str(axis) + " provided with -coord option is out of range of input image");
 
       header_out.size (axis) = pos[axis].size();
+      header_in.set_access_indices (axis, pos[axis]);
       if (axis == 3) {
         const auto grad = DWI::get_DW_scheme (header_in);
         if (grad.rows()) {
@@ -17,6 +17,7 @@
 
 #include "command.h"
 #include "image.h"
+#include "image_span.h"
 #include "memory.h"
 #include "phase_encoding.h"
 #include "progressbar.h"
@@ -254,19 +255,21 @@ class MagMax { NOMEMALIGN
 
 
 template <class Operation>
-class AxisKernel { NOMEMALIGN
+class AxisKernel { MEMALIGN(AxisKernel<Operation>)
   public:
-    AxisKernel (size_t axis) : axis (axis) { }
+    AxisKernel (const Image<value_type>& in, size_t axis) : span (in, axis) { }
 
     template <class InputImageType, class OutputImageType>
       void operator() (InputImageType& in, OutputImageType& out) {
+        assign_pos_of (in).to (span.parent());
+        span.load();
         Operation op;
-        for (auto l = Loop (axis) (in); l; ++l)
-          op (in.value());
+        for (ssize_t n = 0; n < span.size(); ++n)
+          op (span[n]);
         out.value() = op.result();
       }
   protected:
-    const size_t axis;
+    ImageSpan<value_type> span;
 };
 
 
@@ -371,18 +374,18 @@ void run ()
     auto loop = ThreadedLoop (std::string("computing ") + operations[op] + " along axis " + str(axis) + "...", image_out);
 
     switch (op) {
-      case 0: loop.run  (AxisKernel<Mean>   (axis), image_in, image_out); return;
-      case 1: loop.run  (AxisKernel<Median> (axis), image_in, image_out); return;
-      case 2: loop.run  (AxisKernel<Sum>    (axis), image_in, image_out); return;
-      case 3: loop.run  (AxisKernel<Product>(axis), image_in, image_out); return;
-      case 4: loop.run  (AxisKernel<RMS>    (axis), image_in, image_out); return;
-      case 5: loop.run  (AxisKernel<NORM2>  (axis), image_in, image_out); return;
-      case 6: loop.run  (AxisKernel<Var>    (axis), image_in, image_out); return;
-      case 7: loop.run  (AxisKernel<Std>    (axis), image_in, image_out); return;
-      case 8: loop.run  (AxisKernel<Min>    (axis), image_in, image_out); return;
-      case 9: loop.run  (AxisKernel<Max>    (axis), image_in, image_out); return;
-      case 10: loop.run  (AxisKernel<AbsMax> (axis), image_in, image_out); return;
-      case 11: loop.run (AxisKernel<MagMax> (axis), image_in, image_out); return;
+      case 0:  loop.run (AxisKernel<Mean>    (image_in, axis), image_in, image_out); return;
+      case 1:  loop.run (AxisKernel<Median>  (image_in, axis), image_in, image_out); return;
+      case 2:  loop.run (AxisKernel<Sum>     (image_in, axis), image_in, image_out); return;
+      case 3:  loop.run (AxisKernel<Product> (image_in, axis), image_in, image_out); return;
+      case 4:  loop.run (AxisKernel<RMS>     (image_in, axis), image_in, image_out); return;
+      case 5:  loop.run (AxisKernel<NORM2>   (image_in, axis), image_in, image_out); return;
+      case 6:  loop.run (AxisKernel<Var>     (image_in, axis), image_in, image_out); return;
+      case 7:  loop.run (AxisKernel<Std>     (image_in, axis), image_in, image_out); return;
+      case 8:  loop.run (AxisKernel<Min>     (image_in, axis), image_in, image_out); return;
+      case 9:  loop.run (AxisKernel<Max>     (image_in, axis), image_in, image_out); return;
+      case 10: loop.run (AxisKernel<AbsMax>  (image_in, axis), image_in, image_out); return;
+      case 11: loop.run (AxisKernel<MagMax>  (image_in, axis), image_in, image_out); return;
       default: assert (0);
     }
 
@@ -18,6 +18,7 @@
 #include "command.h"
 #include "math/SH.h"
 #include "image.h"
+#include "image_span.h"
 #include "dwi/gradient.h"
 
 
@@ -62,29 +63,25 @@ class SH2Amp { MEMALIGN(SH2Amp)
     template <class MatrixType>
     SH2Amp (const MatrixType& dirs, const size_t lmax, bool nonneg) :
       transformer (dirs.template cast<value_type>(), lmax),
-      nonnegative (nonneg),
-      sh (transformer.n_SH()),
-      amp (transformer.n_amp()) { }
+      nonnegative (nonneg) { }
 
-    void operator() (Image<value_type>& in, Image<value_type>& out) {
-      sh = in.row (3);
-      transformer.SH2A(amp, sh);
+    void operator() (const ImageSpan<value_type>& in, ImageSpan<value_type>& out) {
+      auto amp = out.matrix();
+      transformer.SH2A(amp, in.matrix());
       if (nonnegative)
         amp = amp.cwiseMax(value_type(0.0));
-      out.row (3) = amp;
     }
 
   private:
     const Math::SH::Transform<value_type> transformer;
     const bool nonnegative;
-    Eigen::Matrix<value_type, Eigen::Dynamic, 1> sh, amp;
 };
 
 
 
 void run ()
 {
-  auto sh_data = Image<value_type>::open(argument[0]);
+  const auto sh_data = Image<value_type>::open(argument[0]);
   Math::SH::check (sh_data);
 
   Header amp_header (sh_data);
@@ -116,6 +113,6 @@ void run ()
   auto amp_data = Image<value_type>::create(argument[2], amp_header);
 
   SH2Amp sh2amp (directions, Math::SH::LforN (sh_data.size(3)), get_options("nonnegative").size());
-  ThreadedLoop("computing amplitudes", sh_data, 0, 3, 2).run (sh2amp, sh_data, amp_data);
+  ThreadedLoop("computing amplitudes", sh_data, { 3, 0, 1, 2 }, 1).run_span (sh2amp, sh_data, write_only (amp_data));
 
 }
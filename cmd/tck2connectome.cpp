@@ -117,14 +117,14 @@ void execute (Image<node_t>& node_image, const node_t max_node_index, const std:
   // Multi-threaded connectome construction
   if (tck2nodes->provides_pair()) {
     Thread::run_queue (
-        loader,
+        Thread::multi (loader, loader.num_threads()),
         Thread::batch (Tractography::Streamline<float>()),
         Thread::multi (mapper),
         Thread::batch (Mapped_track_nodepair()),
         connectome);
   } else {
     Thread::run_queue (
-        loader,
+        Thread::multi (loader, loader.num_threads()),
         Thread::batch (Tractography::Streamline<float>()),
         Thread::multi (mapper),
         Thread::batch (Mapped_track_nodelist()),
@@ -170,7 +170,7 @@ void run ()
     mapper.set_use_precise_mapping (true);
     TrackProcessor tract_processor (index_image, directions, fixel_TDI, angular_threshold);
     Thread::run_queue (
-        loader,
+        Thread::multi (loader, loader.num_threads()),
         Thread::batch (DWI::Tractography::Streamline<float>()),
         mapper,
         Thread::batch (SetVoxelDir()),
@@ -15,6 +15,7 @@
 
 #include "command.h"
 #include "image.h"
+#include "thread.h"
 
 #include "dwi/tractography/properties.h"
 #include "dwi/tractography/roi.h"
@@ -208,7 +209,10 @@ void usage ()
 
   + DWI::Tractography::Algorithms::iFOD2Option
 
-  + DWI::GradImportOptions();
+  + DWI::GradImportOptions()
+
+  + OptionGroup ("Thread placement options")
+  + Thread::AffinityOption;
 
 }
 
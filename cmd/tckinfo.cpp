@@ -17,6 +17,7 @@
 #include "progressbar.h"
 #include "file/ofstream.h"
 #include "dwi/tractography/file.h"
+#include "dwi/tractography/index.h"
 #include "dwi/tractography/properties.h"
 
 using namespace MR;
@@ -33,7 +34,14 @@ void usage ()
   + Argument ("tracks", "the input track file.").type_tracks_in().allow_multiple();
 
   OPTIONS
-  + Option ("count", "count number of tracks in file explicitly, ignoring the header");
+  + Option ("count", "count number of tracks in file explicitly, ignoring the header")
+
+  + Option ("index", "generate an offset index for each track file, stored alongside it "
+                     "with the suffix \".idx\" appended to the file name. This lists the "
+                     "position of every streamline within the file, allowing commands that "
+                     "only need a subset of the streamlines to read them directly, and large "
+                     "files to be split exactly between threads. The index is ignored if the "
+                     "track file is subsequently modified.");
 
 }
 
@@ -43,6 +51,7 @@ void usage ()
 void run ()
 {
   bool actual_count = get_options ("count").size();
+  bool create_index = get_options ("index").size();
 
   for (size_t i = 0; i < argument.size(); ++i) {
     Tractography::Properties properties;
@@ -57,6 +66,9 @@ void run ()
       std::cout << "    " << S << i->second << "\n";
     }
 
+    if (file.quantisation_step())
+      std::cout << "    quantisation:         " << file.quantisation_step() << "\n";
+
     if (properties.comments.size()) {
       std::cout << "    Comments:             ";
       for (vector<std::string>::iterator i = properties.comments.begin(); i != properties.comments.end(); ++i)
@@ -81,6 +93,13 @@ void run ()
       std::cout << "actual count in file: " << count << "\n";
     }
 
+    if (create_index) {
+      Tractography::Index index;
+      index.build (argument[i]);
+      index.save (argument[i]);
+      std::cout << "offset index for " << index.size() << " tracks written to: \"" << Tractography::Index::path (argument[i]) << "\"\n";
+    }
+
 
   }
 }
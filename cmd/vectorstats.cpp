@@ -14,6 +14,7 @@
 
 
 #include "command.h"
+#include "memory_usage.h"
 #include "progressbar.h"
 #include "types.h"
 
@@ -111,6 +112,7 @@ void run()
 
   // Load input data
   matrix_type data (num_elements, filenames.size());
+  const auto data_memory = MemoryUsage::track (data);
   {
     ProgressBar progress ("Loading input vector data", filenames.size());
     for (size_t subject = 0; subject < filenames.size(); subject++) {
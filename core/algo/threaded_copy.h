@@ -17,10 +17,16 @@
 #define __algo_threaded_copy_h__
 
 #include "algo/threaded_loop.h"
+#include "progressbar.h"
+
+// size of the blocks of data copied by each thread in raw_copy():
+#define RAW_COPY_BLOCK_SIZE (16*1024*1024)
 
 namespace MR
 {
 
+  template <typename ValueType> class Image;
+
   //! \cond skip
   namespace {
 
@@ -31,12 +37,126 @@ namespace MR
         }
     };
 
+
+    // copy size bytes from source to destination using multiple threads,
+    // in blocks of RAW_COPY_BLOCK_SIZE:
+    inline void __threaded_memcpy (uint8_t* destination, const uint8_t* source, size_t size, ProgressBar* progress)
+    {
+      struct Shared { NOMEMALIGN
+        uint8_t* destination;
+        const uint8_t* source;
+        const size_t size;
+        ProgressBar* progress;
+        size_t next;
+        std::mutex mutex;
+
+        bool get (size_t& offset) {
+          std::lock_guard<std::mutex> lock (mutex);
+          if (next >= size)
+            return false;
+          offset = next;
+          next += RAW_COPY_BLOCK_SIZE;
+          if (progress)
+            ++(*progress);
+          return true;
+        }
+      } shared = { destination, source, size, progress, 0, { } };
+
+      struct PerThread { NOMEMALIGN
+        Shared& shared;
+        void execute () {
+          size_t offset;
+          while (shared.get (offset))
+            memcpy (shared.destination + offset, shared.source + offset,
+                std::min<size_t> (RAW_COPY_BLOCK_SIZE, shared.size - offset));
+        }
+      } loop_thread = { shared };
+
+      const size_t num_threads = std::min (Thread::number_of_threads(), (size + RAW_COPY_BLOCK_SIZE - 1) / RAW_COPY_BLOCK_SIZE);
+      if (num_threads > 1)
+        Thread::run (Thread::multi (loop_thread, num_threads), "raw copy threads").wait();
+      else
+        loop_thread.execute();
+    }
+
+
+    template <class InputImageType, class OutputImageType>
+      inline bool __raw_copy (const std::string&, InputImageType&, OutputImageType&, ssize_t) { return false; }
+
+    template <typename InputValueType, typename OutputValueType>
+      bool __raw_copy (const std::string& message, Image<InputValueType>& source, Image<OutputValueType>& destination, ssize_t first)
+      {
+        const auto& in (*source.buffer);
+        const auto& out (*destination.buffer);
+        if (in.data_buffer || out.data_buffer || !in.get_io() || !out.get_io() ||
+            in.get_io()->nsegments() != 1 || out.get_io()->nsegments() != 1)
+          return false;
+        if (in.datatype() != out.datatype() || in.datatype().bits() % 8 ||
+            in.intensity_offset() != out.intensity_offset() || in.intensity_scale() != out.intensity_scale())
+          return false;
+        if (source.ndim() != destination.ndim())
+          return false;
+
+        // source may only differ in extent along its outermost axis:
+        size_t outer = 0;
+        for (size_t n = 1; n < source.ndim(); ++n)
+          if (std::abs (source.stride (n)) > std::abs (source.stride (outer)))
+            outer = n;
+        for (size_t n = 0; n < source.ndim(); ++n) {
+          if (source.stride (n) != destination.stride (n))
+            return false;
+          if (source.size (n) != destination.size (n) && (n != outer || source.stride (n) < 0))
+            return false;
+        }
+        if (first < 0 || first + destination.size (outer) > source.size (outer))
+          return false;
+
+        const size_t bytes = in.datatype().bytes();
+        const size_t size = voxel_count (destination) * bytes;
+        DEBUG ("copying raw data from \"" + source.name() + "\" to \"" + destination.name() + "\"");
+        std::unique_ptr<ProgressBar> progress (message.size() ?
+            new ProgressBar (message, (size + RAW_COPY_BLOCK_SIZE - 1) / RAW_COPY_BLOCK_SIZE) : nullptr);
+        __threaded_memcpy (out.get_io()->segment (0), in.get_io()->segment (0) + first * source.stride (outer) * bytes,
+            size, progress.get());
+        return true;
+      }
+
   }
 
   //! \endcond
 
 
 
+  //! copy \a source to \a destination as raw bytes, where their layouts match
+  /*! This provides a fast path for copying image data, for the frequently
+   * encountered case where the data are to be copied unmodified (e.g.
+   * format conversion, or cropping along the outermost axis). This is only
+   * possible if \a source and \a destination are both Image objects (rather
+   * than adapters), accessing the data in place (i.e. without preloading),
+   * with the same datatype, intensity scaling, strides and dimensions,
+   * except that \a source may be larger along its outermost axis (i.e. that
+   * with the largest stride): in this case, the positions along that axis
+   * starting from \a first are copied. The data are then copied as large
+   * contiguous blocks, using multiple threads.
+   *
+   * \return \c true if the data were copied, \c false otherwise (in which
+   * case the images are left unmodified). */
+  template <class InputImageType, class OutputImageType>
+    inline bool raw_copy (InputImageType& source, OutputImageType& destination, ssize_t first = 0)
+    {
+      return __raw_copy (std::string(), source, destination, first);
+    }
+
+  //! as raw_copy(), displaying a progress bar with the text in \a message
+  /*! The progress bar is only displayed if the data can be copied. */
+  template <class InputImageType, class OutputImageType>
+    inline bool raw_copy_with_progress_message (const std::string& message, InputImageType& source, OutputImageType& destination, ssize_t first = 0)
+    {
+      return __raw_copy (message, source, destination, first);
+    }
+
+
+
 
   template <class InputImageType, class OutputImageType>
     inline void threaded_copy (
@@ -57,6 +177,8 @@ namespace MR
         size_t to_axis = std::numeric_limits<size_t>::max(),
         size_t num_axes_in_thread = 1)
     {
+      if (from_axis == 0 && to_axis >= source.ndim() && raw_copy (source, destination))
+        return;
       ThreadedLoop (source, from_axis, to_axis, num_axes_in_thread)
         .run (__copy_func(), source, destination);
     }
@@ -85,6 +207,8 @@ namespace MR
         size_t to_axis = std::numeric_limits<size_t>::max(), 
         size_t num_axes_in_thread = 1)
     {
+      if (from_axis == 0 && to_axis >= source.ndim() && raw_copy_with_progress_message (message, source, destination))
+        return;
       ThreadedLoop (message, source, from_axis, to_axis, num_axes_in_thread)
         .run (__copy_func(), source, destination);
     }
@@ -113,6 +237,37 @@ namespace MR
           source, destination, from_axis, to_axis, num_axes_in_thread);
     }
 
+
+
+
+  //! copy \a source to \a destination one volume at a time
+  /*! The volumes (i.e. positions along axis 3) of \a destination are
+   * copied in order, each using a threaded copy over the first 3 axes.
+   * Before volume \a n is copied, \a wait (n) is invoked, and once it has
+   * been copied, destination.publish_volumes (n+1) is invoked. This allows
+   * images streamed between commands via a pipe to be processed as each
+   * volume becomes available: \a wait should invoke
+   * Image::wait_for_volumes() on the image(s) underlying \a source, as
+   * appropriate for the volumes of \a source that map onto volume \a n of
+   * \a destination. Both images must be 4D. */
+  template <class InputImageType, class OutputImageType, class WaitFunctor>
+    inline void threaded_copy_volumes_with_progress_message (
+        const std::string& message,
+        InputImageType& source,
+        OutputImageType& destination,
+        WaitFunctor&& wait)
+    {
+      assert (source.ndim() == 4 && destination.ndim() == 4);
+      ProgressBar progress (message, destination.size (3));
+      for (ssize_t n = 0; n < destination.size (3); ++n) {
+        wait (n);
+        source.index (3) = destination.index (3) = n;
+        ThreadedLoop (source, 0, 3).run (__copy_func(), source, destination);
+        destination.publish_volumes (n+1);
+        ++progress;
+      }
+    }
+
 }
 
 #endif
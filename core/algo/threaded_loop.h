@@ -16,6 +16,8 @@
 #ifndef __algo_threaded_loop_h__
 #define __algo_threaded_loop_h__
 
+#include <atomic>
+
 #include "debug.h"
 #include "algo/loop.h"
 #include "algo/iterator.h"
@@ -24,6 +26,8 @@
 namespace MR
 {
 
+  template <typename ValueType> class ImageSpan;
+
   /** \addtogroup thread_classes
    * @{
    *
@@ -58,14 +62,20 @@ namespace MR
    * been set to the z and volume axes (i.e. axes 2 & 3). Each thread will do
    * the following:
    *
-   * 1. lock the loop mutex, obtain a new set of z & volume coordinates, then
-   *    release the mutex so other threads can obtain their own unique set of
-   *    coordinates to process;
-   * 2. set the position of all `ImageType` classes to be processed according
-   *    to these coordinates;
-   * 3. iterate over the x & y axes, invoking the user-supplied functor each
-   *    time;
-   * 4. repeat from step 1 until all the data have been processed.
+   * 1. obtain a new chunk of consecutive z & volume coordinates to process,
+   *    either from its own range of coordinates (each thread is initially
+   *    assigned an equal share of the outer loop), or once its own range is
+   *    exhausted, by stealing half of the largest range remaining to
+   *    another thread;
+   * 2. for each set of coordinates in the chunk, set the position of all
+   *    `ImageType` classes to be processed according to these coordinates,
+   *    and iterate over the x & y axes, invoking the user-supplied functor
+   *    each time;
+   * 3. repeat from step 1 until all the data have been processed.
+   *
+   * The number of outer loop positions in each chunk can be set using the
+   * grain() method; by default, it is chosen so that each thread processes
+   * around 16 chunks.
    *
    *
    * \section threaded_loop_constructor Instantiating a ThreadedLoop() object
@@ -230,6 +240,34 @@ namespace MR
    * invocation - the functor will need to then implement looping over the
    * inner axes from the position provided in the `Iterator`.
    *
+   * \section threaded_loop_run_span The run_span() method
+   *
+   * Where the inner loop runs over a single axis, the run_span() method can
+   * be used to process each line of voxels along that axis as a whole. The
+   * function or functor will then be invoked with an ImageSpan for each of
+   * the images supplied, providing direct access to the values along the
+   * line as a contiguous array. This avoids indexing the image voxel by
+   * voxel, and allows the use of Eigen maps in the kernel. For example:
+   *
+   * \code
+   * #include "image_span.h"
+   *
+   * auto in = Image<float>::open (argument[0]);
+   * auto out = Image<float>::create (argument[1], in);
+   *
+   * ThreadedLoop (in, 0, 3, 1).run_span (
+   *     [](ImageSpan<float>& out, ImageSpan<float>& in) {
+   *       out.array() = in.array().exp();
+   *     }, out, in);
+   * \endcode
+   *
+   * Values along the line are accessed in place where possible (direct IO
+   * with unit stride along the axis), and are otherwise copied into a
+   * per-thread buffer and written back once the functor returns. Images
+   * passed as const, or opened read-only, are never written back. Images
+   * whose lines are entirely overwritten can be passed as write_only (out),
+   * in which case their current values are not fetched beforehand.
+   *
    * \sa Loop
    * \sa Thread::run()
    * \sa thread_queue
@@ -303,11 +341,74 @@ namespace MR
       };
 
 
+    template <class Functor, class... SpanType>
+      struct ThreadedLoopRunSpan
+      { MEMALIGN(ThreadedLoopRunSpan<Functor,SpanType...>)
+        const vector<size_t>& outer_axes;
+        typename std::remove_reference<Functor>::type func;
+        std::tuple<SpanType...> spans;
+
+        ThreadedLoopRunSpan (const vector<size_t>& outer_axes, const Functor& functor, const SpanType&... spans) :
+          outer_axes (outer_axes),
+          func (functor),
+          spans (spans...) { }
+
+        struct Load { NOMEMALIGN
+          const Iterator& pos;
+          const vector<size_t>& axes;
+          template <class SpanT>
+            FORCE_INLINE void operator() (SpanT& span) const {
+              assign_pos_of (pos, axes).to (span.parent());
+              span.load();
+            }
+        };
+
+        struct Store { NOMEMALIGN
+          template <class SpanT>
+            FORCE_INLINE void operator() (SpanT& span) const { span.store(); }
+        };
+
+        void operator() (const Iterator& pos) {
+          apply (Load { pos, outer_axes }, spans);
+          unpack (func, spans);
+          apply (Store(), spans);
+        }
+      };
+
+
+    // a contiguous range [first, last) of linear indices into the outer
+    // loop, from which the owning thread takes chunks from the front, and
+    // other threads can steal from the back:
+    struct ThreadedLoopRange { NOMEMALIGN
+      std::atomic<size_t> first, last;
+      std::mutex mutex;
+      size_t size () const {
+        const size_t f = first, l = last;
+        return l > f ? l - f : 0;
+      }
+    };
+
+
     template <class OuterLoopType>
       struct ThreadedLoopRunOuter { MEMALIGN(ThreadedLoopRunOuter<OuterLoopType>)
         Iterator iterator;
         OuterLoopType outer_loop;
         vector<size_t> inner_axes;
+        size_t grain_size;
+
+        //! set the number of outer loop positions to process per chunk
+        /*! Each thread processes the positions of the outer loop in chunks
+         * of \a grain consecutive positions. By default (or if \a grain is
+         * zero), this is set such that each thread processes around 16
+         * chunks, which allows the work to be balanced between threads
+         * while keeping the overhead of scheduling low. A smaller value may
+         * help if the cost of processing each position varies greatly
+         * (e.g. for masked operations on small images); a larger value if
+         * the cost of each position is very small. For example:
+         * \code
+         * ThreadedLoop (in).grain (4).run (func, in, out);
+         * \endcode */
+        ThreadedLoopRunOuter& grain (size_t grain) { grain_size = grain; return *this; }
 
         //! invoke \a functor (const Iterator& pos) per voxel <em> in the outer axes only</em>
         template <class Functor>
@@ -319,34 +420,119 @@ namespace MR
               return;
             }
 
-            std::mutex mutex;
-
+            // each thread starts with its own range of outer loop positions,
+            // and processes it in chunks; once its range is exhausted, it
+            // steals half of the largest remaining range from another thread.
+            // The shared loop is only used to display progress.
             struct Shared { MEMALIGN(Shared)
-              Iterator& iterator;
               decltype (outer_loop (iterator)) loop;
-              std::mutex& mutex;
-              FORCE_INLINE bool next (Iterator& pos) {
-                std::lock_guard<std::mutex> lock (mutex);
-                if (loop) {
-                  assign_pos_of (iterator, loop.axes).to (pos);
-                  ++loop;
+              const Iterator start;
+              const vector<size_t>& axes;
+              const size_t grain;
+              vector<ThreadedLoopRange> ranges;
+              std::atomic<size_t> next_thread;
+              std::mutex progress_mutex;
+
+              Shared (OuterLoopType& outer_loop, Iterator& iterator, size_t num_threads, size_t grain_size) :
+                loop (outer_loop (iterator)), start (iterator), axes (outer_loop.axes),
+                grain (grain_size ? grain_size : std::max<size_t> (1, total() / (16*num_threads))),
+                ranges (num_threads), next_thread (0) {
+                  const size_t num = total();
+                  for (size_t n = 0; n < num_threads; ++n) {
+                    ranges[n].first = (n * num) / num_threads;
+                    ranges[n].last = ((n+1) * num) / num_threads;
+                  }
+                }
+
+              size_t total () const {
+                size_t num = 1;
+                for (auto axis : axes)
+                  num *= start.size (axis);
+                return num;
+              }
+
+              // claim the next chunk [first, last) for thread n:
+              bool next (size_t n, size_t& first, size_t& last) {
+                ThreadedLoopRange& own (ranges[n]);
+                {
+                  std::lock_guard<std::mutex> lock (own.mutex);
+                  if (own.first < own.last) {
+                    first = own.first;
+                    last = own.first = std::min<size_t> (own.last, first + grain);
+                    return true;
+                  }
+                }
+                while (true) {
+                  // find the thread with the most work remaining
+                  // (sizes may be out of date, this is only a heuristic):
+                  size_t victim = n, remaining = 0;
+                  for (size_t i = 0; i < ranges.size(); ++i) {
+                    if (i != n && ranges[i].size() > remaining) {
+                      remaining = ranges[i].size();
+                      victim = i;
+                    }
+                  }
+                  if (victim == n)
+                    return false;
+                  {
+                    ThreadedLoopRange& other (ranges[victim]);
+                    std::lock_guard<std::mutex> lock (other.mutex);
+                    if (other.first >= other.last)
+                      continue;
+                    last = other.last;
+                    first = other.last = other.last - (other.last - other.first + 1) / 2;
+                  }
+                  if (last - first > grain) {
+                    // keep the remainder of the stolen range for later:
+                    std::lock_guard<std::mutex> lock (own.mutex);
+                    own.last = last;
+                    own.first = last = first + grain;
+                  }
                   return true;
                 }
-                else return false;
               }
-            } shared = { iterator, outer_loop (iterator), mutex };
+
+              void set_position (size_t index, Iterator& pos) const {
+                for (auto axis : axes) {
+                  pos.index (axis) = index % pos.size (axis);
+                  index /= pos.size (axis);
+                }
+              }
+
+              void done (size_t num) {
+                std::lock_guard<std::mutex> lock (progress_mutex);
+                for (size_t i = 0; i < num; ++i)
+                  ++loop;
+              }
+            };
+
+            const size_t num_threads = Thread::number_of_threads();
+            Shared shared (outer_loop, iterator, num_threads, grain_size);
 
             struct PerThread { MEMALIGN(PerThread)
               Shared& shared;
               typename std::remove_reference<Functor>::type func;
               void execute () {
-                Iterator pos = shared.iterator;
-                while (shared.next (pos))
-                  func (pos);
+                const size_t n = shared.next_thread++;
+                Iterator pos = shared.start;
+                size_t first, last;
+                while (shared.next (n, first, last)) {
+                  shared.set_position (first, pos);
+                  for (size_t i = first; i < last; ++i) {
+                    func (pos);
+                    // advance to the next position in the outer loop:
+                    for (auto axis : shared.axes) {
+                      if (++pos.index (axis) < pos.size (axis))
+                        break;
+                      pos.index (axis) = 0;
+                    }
+                  }
+                  shared.done (last - first);
+                }
               }
             } loop_thread = { shared, functor };
 
-            Thread::run (Thread::multi (loop_thread), "loop threads").wait();
+            Thread::run (Thread::multi (loop_thread, num_threads), "loop threads").wait();
           }
 
 
@@ -364,6 +550,28 @@ namespace MR
             check_app_exit_code();
           }
 
+
+
+        //! invoke \a functor (ImageSpan<>& span...) per line of voxels along the inner axis
+        /*! This requires a single inner axis, and can only be used with
+         * Image objects (not adapters). For each position in the outer axes,
+         * an ImageSpan is loaded for each of the images supplied, \a functor
+         * is invoked with these spans, and any modified values are written
+         * back to the images, other than those passed as const. Images
+         * passed via write_only() are not read. See ImageSpan for details. */
+        template <class Functor, class... ImageType>
+          void run_span (Functor&& functor, ImageType&&... vox)
+          {
+            assert (inner_axes.size() == 1);
+            ThreadedLoopRunSpan<
+              typename std::remove_reference<Functor>::type,
+              ImageSpan<typename std::remove_reference<ImageType>::type::value_type>...
+                > loop_thread (outer_loop.axes, functor,
+                    ImageSpan<typename std::remove_reference<ImageType>::type::value_type> (vox, inner_axes[0])...);
+            run_outer (loop_thread);
+            check_app_exit_code();
+          }
+
       };
   }
 
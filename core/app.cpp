@@ -22,6 +22,7 @@
 
 #include "app.h"
 #include "debug.h"
+#include "profiler.h"
 #include "progressbar.h"
 #include "file/path.h"
 #include "file/config.h"
@@ -56,6 +57,9 @@ namespace MR
           "Caution: Using the same file as input and output might cause unexpected behaviour.")
       + Option ("nthreads", "use this number of threads in multi-threaded applications (set to 0 to disable multi-threading).")
         + Argument ("number").type_integer (0)
+      + Option ("profile", "record the wall time, CPU time and peak memory usage of each processing phase and thread, "
+          "and write these to the specified file in Chrome trace-event JSON format once the command completes.")
+        + Argument ("file").type_file_out()
       + Option ("help", "display this information page and exit.")
       + Option ("version", "display version information and exit.");
 
@@ -910,6 +914,9 @@ namespace MR
         WARN ("existing output files will be overwritten");
         overwrite_files = true;
       }
+      auto opt = get_options ("profile");
+      if (opt.size())
+        Profiler::start (opt[0][0]);
     }
 
 
@@ -23,6 +23,7 @@
 
 #include "app.h"
 #include "exec_version.h"
+#include "profiler.h"
 #ifdef MRTRIX_PROJECT
 namespace MR {
   namespace App {
@@ -98,8 +99,11 @@ int main (int cmdline_argc, char** cmdline_argv)
 #endif
     ::MR::App::parse ();
     run ();
+    ::MR::MemoryUsage::report();
+    ::MR::Profiler::write();
   }
   catch (::MR::Exception& E) {
+    ::MR::Profiler::write();
     E.display();
     return 1;
   }
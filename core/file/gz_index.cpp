@@ -0,0 +1,281 @@
+/*
+ * Copyright (c) 2008-2018 the MRtrix3 contributors.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at http://mozilla.org/MPL/2.0/
+ *
+ * MRtrix3 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * For more details, see http://www.mrtrix.org/
+ */
+
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <sys/stat.h>
+#include <zlib.h>
+
+#include "file/gz_index.h"
+#include "debug.h"
+#include "exception.h"
+#include "raw.h"
+
+namespace MR
+{
+  namespace File
+  {
+
+    namespace {
+
+      constexpr size_t window_size = 32768;
+      constexpr size_t input_chunk_size = 262144;
+      // minimum separation between consecutive access points in the
+      // uncompressed stream:
+      constexpr int64_t access_point_spacing = 4194304;
+
+      constexpr const char* sidecar_magic = "MRGZIDX1";
+
+      // ensure inflateEnd() is invoked whichever way we leave read():
+      class InflateStream : public z_stream { NOMEMALIGN
+        public:
+          InflateStream (int window_bits) {
+            memset (static_cast<z_stream*> (this), 0, sizeof (z_stream));
+            if (inflateInit2 (this, window_bits) != Z_OK)
+              throw Exception ("error initialising zlib decompression");
+          }
+          ~InflateStream () { inflateEnd (this); }
+      };
+
+      template <typename ValueType>
+        inline void put (std::ofstream& out, ValueType value) {
+          char buf[sizeof (ValueType)];
+          Raw::store_LE (value, buf);
+          out.write (buf, sizeof (ValueType));
+        }
+
+      template <typename ValueType>
+        inline ValueType get (std::ifstream& in) {
+          char buf[sizeof (ValueType)];
+          if (!in.read (buf, sizeof (ValueType)))
+            throw Exception ("unexpected end of file");
+          return Raw::fetch_LE<ValueType> (buf);
+        }
+
+    }
+
+
+
+    GZIndex::GZIndex (const std::string& filename) :
+      filename (filename),
+      file_size (0),
+      file_mtime (0),
+      is_modified (false)
+    {
+      struct stat sbuf;
+      if (stat (filename.c_str(), &sbuf))
+        throw Exception ("cannot stat file \"" + filename + "\": " + strerror (errno));
+      file_size = sbuf.st_size;
+      file_mtime = sbuf.st_mtime;
+      load();
+    }
+
+
+
+    void GZIndex::read (int64_t first, int64_t last, uint8_t* data, const std::function<void(size_t)>& progress)
+    {
+      if (first >= last)
+        return;
+
+      std::ifstream in (filename, std::ios::in | std::ios::binary);
+      if (!in)
+        throw Exception ("error opening file \"" + filename + "\": " + strerror (errno));
+
+      // locate the nearest access point preceding the region requested:
+      auto next = std::upper_bound (points.begin(), points.end(), first,
+          [](int64_t pos, const Point& p) { return pos < p.out; });
+      const Point* point = next == points.begin() ? nullptr : &*(next-1);
+
+      // access points lie within the raw deflate stream of a gzip member:
+      bool raw = point;
+      InflateStream zs (raw ? -MAX_WBITS : 16+MAX_WBITS);
+
+      uint8_t window[window_size];
+      int64_t pos_in = 0, pos_out = 0, member_start = 0;
+      zs.next_out = window;
+      zs.avail_out = window_size;
+
+      if (point) {
+        pos_in = point->in;
+        pos_out = point->out;
+        member_start = point->out - point->window.size();
+        in.seekg (point->in - (point->bits ? 1 : 0));
+        if (point->bits) {
+          const int c = in.get();
+          if (c < 0)
+            throw Exception ("unexpected end of file while uncompressing \"" + filename + "\"");
+          inflatePrime (&zs, point->bits, c >> (8 - point->bits));
+        }
+        if (point->window.size()) {
+          inflateSetDictionary (&zs, point->window.data(), point->window.size());
+          memcpy (window, point->window.data(), point->window.size());
+          zs.next_out += point->window.size();
+          zs.avail_out -= point->window.size();
+        }
+      }
+
+      vector<uint8_t> input (input_chunk_size);
+      size_t trailer_remaining = 0;
+
+      while (pos_out < last) {
+        if (!zs.avail_in) {
+          in.read (reinterpret_cast<char*> (input.data()), input.size());
+          zs.next_in = input.data();
+          zs.avail_in = in.gcount();
+          if (!zs.avail_in)
+            throw Exception ("unexpected end of file while uncompressing \"" + filename + "\"");
+        }
+
+        if (trailer_remaining) {
+          // skip over member trailer, and prepare to read next member header:
+          const size_t n = std::min<size_t> (trailer_remaining, zs.avail_in);
+          zs.next_in += n;
+          zs.avail_in -= n;
+          pos_in += n;
+          trailer_remaining -= n;
+          if (!trailer_remaining) {
+            inflateReset2 (&zs, 16+MAX_WBITS);
+            raw = false;
+          }
+          continue;
+        }
+
+        if (!zs.avail_out) {
+          zs.next_out = window;
+          zs.avail_out = window_size;
+        }
+
+        uint8_t* out = zs.next_out;
+        const size_t avail_in = zs.avail_in;
+        const int status = inflate (&zs, Z_BLOCK);
+        pos_in += avail_in - zs.avail_in;
+
+        const int64_t produced = zs.next_out - out;
+        const int64_t from = std::max (pos_out, first), to = std::min (pos_out + produced, last);
+        if (from < to) {
+          memcpy (data + (from - first), out + (from - pos_out), to - from);
+          if (progress)
+            progress (to - from);
+        }
+        pos_out += produced;
+
+        if (status == Z_STREAM_END) {
+          // end of gzip member - any further data belong to a new member:
+          if (raw)
+            trailer_remaining = 8;
+          else
+            inflateReset (&zs);
+          member_start = pos_out;
+          continue;
+        }
+        if (status != Z_OK && status != Z_BUF_ERROR)
+          throw Exception ("error uncompressing GZ file \"" + filename + "\": " + (zs.msg ? zs.msg : "unknown zlib error"));
+
+        // record a new access point at the end of a deflate block, if
+        // sufficiently far beyond the end of the current index:
+        if ((zs.data_type & 128) && !(zs.data_type & 64) &&
+            (points.empty() || pos_out >= points.back().out + access_point_spacing)) {
+          const size_t history = std::min<int64_t> (pos_out - member_start, window_size);
+          const size_t head = window_size - zs.avail_out;
+          Point p { pos_in, pos_out, zs.data_type & 7, vector<uint8_t> (history) };
+          if (history <= head) {
+            memcpy (p.window.data(), window + head - history, history);
+          }
+          else {
+            memcpy (p.window.data(), window + window_size - (history - head), history - head);
+            memcpy (p.window.data() + history - head, window, head);
+          }
+          points.push_back (std::move (p));
+          is_modified = true;
+        }
+      }
+    }
+
+
+
+    void GZIndex::load ()
+    {
+      std::ifstream in (sidecar (filename), std::ios::in | std::ios::binary);
+      if (!in)
+        return;
+
+      try {
+        char magic[8];
+        if (!in.read (magic, 8) || strncmp (magic, sidecar_magic, 8))
+          throw Exception ("invalid magic number");
+        if (get<int64_t> (in) != file_size || get<int64_t> (in) != file_mtime) {
+          DEBUG ("ignoring out of date index file \"" + sidecar (filename) + "\"");
+          return;
+        }
+        const uint64_t num_points = get<uint64_t> (in);
+        vector<uint8_t> compressed;
+        for (uint64_t n = 0; n < num_points; ++n) {
+          Point p;
+          p.in = get<int64_t> (in);
+          p.out = get<int64_t> (in);
+          p.bits = get<uint8_t> (in);
+          p.window.resize (get<uint32_t> (in));
+          compressed.resize (get<uint32_t> (in));
+          if (!in.read (reinterpret_cast<char*> (compressed.data()), compressed.size()))
+            throw Exception ("unexpected end of file");
+          uLongf window_size = p.window.size();
+          if (uncompress (p.window.data(), &window_size, compressed.data(), compressed.size()) != Z_OK || window_size != p.window.size())
+            throw Exception ("corrupt access point window");
+          points.push_back (std::move (p));
+        }
+        DEBUG ("loaded " + str (points.size()) + " access points from index file \"" + sidecar (filename) + "\"");
+      }
+      catch (Exception& E) {
+        points.clear();
+        DEBUG ("error reading index file \"" + sidecar (filename) + "\": " + E[0] + " - ignored");
+      }
+    }
+
+
+
+    void GZIndex::save () const
+    {
+      std::ofstream out (sidecar (filename), std::ios::out | std::ios::binary | std::ios::trunc);
+      if (!out)
+        throw Exception ("error opening index file \"" + sidecar (filename) + "\" for writing: " + strerror (errno));
+
+      out.write (sidecar_magic, 8);
+      put<int64_t> (out, file_size);
+      put<int64_t> (out, file_mtime);
+      put<uint64_t> (out, points.size());
+      vector<uint8_t> compressed;
+      for (const auto& p : points) {
+        uLongf compressed_size = compressBound (p.window.size());
+        compressed.resize (compressed_size);
+        if (compress (compressed.data(), &compressed_size, p.window.data(), p.window.size()) != Z_OK)
+          throw Exception ("error compressing index for GZ file \"" + filename + "\"");
+        put<int64_t> (out, p.in);
+        put<int64_t> (out, p.out);
+        put<uint8_t> (out, p.bits);
+        put<uint32_t> (out, p.window.size());
+        put<uint32_t> (out, compressed_size);
+        out.write (reinterpret_cast<const char*> (compressed.data()), compressed_size);
+      }
+      out.close();
+      if (!out)
+        throw Exception ("error writing index file \"" + sidecar (filename) + "\": " + strerror (errno));
+      DEBUG ("saved " + str (points.size()) + " access points to index file \"" + sidecar (filename) + "\"");
+    }
+
+
+  }
+}
+
@@ -0,0 +1,94 @@
+/*
+ * Copyright (c) 2008-2018 the MRtrix3 contributors.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at http://mozilla.org/MPL/2.0/
+ *
+ * MRtrix3 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * For more details, see http://www.mrtrix.org/
+ */
+
+
+#ifndef __file_gz_index_h__
+#define __file_gz_index_h__
+
+#include <cstdint>
+#include <functional>
+
+#include "types.h"
+
+namespace MR
+{
+  namespace File
+  {
+
+    //! a seek-point index providing random access into a gzip file
+    /*! A gzip stream can normally only be uncompressed sequentially from its
+     * start. This class records access points at regular intervals within
+     * the stream, along with the state needed to resume decompression from
+     * each of them (the bit offset within the compressed stream, and the
+     * preceding 32kB of uncompressed data), following the approach of the
+     * \c zran.c example distributed with zlib. Any portion of the
+     * uncompressed stream can then be retrieved by uncompressing from the
+     * nearest preceding access point only.
+     *
+     * The index is built incrementally as the file is read. If a sidecar
+     * index file (with suffix ".gzidx") matching the gzip file is found, it
+     * is loaded on construction; the index can be written to this file using
+     * save().
+     *
+     * \note read() is safe to call concurrently from multiple threads, as
+     * long as none of the regions requested extend beyond the last access
+     * point currently recorded (see indexed_size()). */
+    class GZIndex { NOMEMALIGN
+      public:
+        GZIndex (const std::string& filename);
+
+        //! uncompress the region [\a first, \a last) of the stream into \a data
+        /*! Any new access points encountered beyond the end of the current
+         * index are added to the index. If provided, \a progress is invoked
+         * with the number of bytes written to \a data as decompression
+         * proceeds. */
+        void read (int64_t first, int64_t last, uint8_t* data,
+            const std::function<void(size_t)>& progress = nullptr);
+
+        //! the number of access points in the index
+        size_t size () const { return points.size(); }
+        //! the offset within the uncompressed stream of access point \a n
+        int64_t position (size_t n) const { return points[n].out; }
+        //! the offset of the last access point currently in the index
+        int64_t indexed_size () const { return points.size() ? points.back().out : 0; }
+
+        //! whether access points have been added since the index was loaded
+        bool modified () const { return is_modified; }
+        //! write the index to its sidecar file
+        void save () const;
+
+        //! the name of the sidecar index file for gzip file \a filename
+        static std::string sidecar (const std::string& filename) { return filename + ".gzidx"; }
+
+      protected:
+        class Point { NOMEMALIGN
+          public:
+            int64_t in, out;
+            int bits;
+            vector<uint8_t> window;
+        };
+
+        std::string filename;
+        int64_t file_size, file_mtime;
+        vector<Point> points;
+        bool is_modified;
+
+        void load ();
+    };
+
+  }
+}
+
+#endif
+
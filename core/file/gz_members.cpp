@@ -0,0 +1,161 @@
+/*
+ * Copyright (c) 2008-2018 the MRtrix3 contributors.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at http://mozilla.org/MPL/2.0/
+ *
+ * MRtrix3 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * For more details, see http://www.mrtrix.org/
+ */
+
+
+#include <cstring>
+#include <fstream>
+#include <zlib.h>
+
+#include "file/gz_members.h"
+#include "exception.h"
+#include "raw.h"
+
+namespace MR
+{
+  namespace File
+  {
+
+    namespace {
+
+      constexpr uint8_t FEXTRA = 0x04;
+      constexpr size_t fixed_header_size = 12; // including XLEN
+      constexpr size_t mrtrix_header_size = fixed_header_size + 8;
+      constexpr size_t trailer_size = 8;
+
+      // return the total size of the member whose header is in head,
+      // or zero if the member is not tagged with its size:
+      size_t tagged_member_size (const uint8_t* head, size_t header_size)
+      {
+        if (head[0] != 0x1f || head[1] != 0x8b || head[2] != Z_DEFLATED || head[3] != FEXTRA)
+          return 0;
+        const uint8_t* field = head + fixed_header_size;
+        const uint8_t* end = head + header_size;
+        while (field + 4 <= end) {
+          const size_t length = Raw::fetch_LE<uint16_t> (field + 2);
+          if (field + 4 + length > end)
+            return 0;
+          if (field[0] == 'M' && field[1] == 'R' && length == 4)
+            return Raw::fetch_LE<uint32_t> (field + 4);
+          if (field[0] == 'B' && field[1] == 'C' && length == 2)
+            return size_t (Raw::fetch_LE<uint16_t> (field + 4)) + 1;
+          field += 4 + length;
+        }
+        return 0;
+      }
+
+    }
+
+
+
+    vector<GZMember> scan_gz_members (const std::string& filename)
+    {
+      std::ifstream in (filename, std::ios::in | std::ios::binary);
+      if (!in)
+        throw Exception ("error opening file \"" + filename + "\": " + strerror (errno));
+      in.seekg (0, std::ios::end);
+      const int64_t file_size = in.tellg();
+
+      vector<GZMember> members;
+      int64_t offset = 0, data_offset = 0;
+      uint8_t head[fixed_header_size + 0xFFFF];
+      while (offset < file_size) {
+        in.seekg (offset);
+        if (!in.read (reinterpret_cast<char*> (head), fixed_header_size))
+          return { };
+        const size_t header_size = fixed_header_size + Raw::fetch_LE<uint16_t> (head + 10);
+        if (head[3] != FEXTRA || !in.read (reinterpret_cast<char*> (head) + fixed_header_size, header_size - fixed_header_size))
+          return { };
+        const size_t size = tagged_member_size (head, header_size);
+        if (size < header_size + trailer_size || offset + int64_t (size) > file_size)
+          return { };
+
+        uint8_t isize[4];
+        in.seekg (offset + size - 4);
+        if (!in.read (reinterpret_cast<char*> (isize), 4))
+          return { };
+        const size_t data_size = Raw::fetch_LE<uint32_t> (isize);
+
+        members.push_back ({ offset, size, data_offset, data_size });
+        offset += size;
+        data_offset += data_size;
+      }
+      return members;
+    }
+
+
+
+    void GZMember::deflate (const uint8_t* data, size_t size, vector<uint8_t>& member)
+    {
+      z_stream zs;
+      memset (&zs, 0, sizeof (zs));
+      if (deflateInit2 (&zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+        throw Exception ("error initialising zlib compression");
+
+      member.resize (mrtrix_header_size + deflateBound (&zs, size) + trailer_size);
+      zs.next_in = const_cast<Bytef*> (data);
+      zs.avail_in = size;
+      zs.next_out = member.data() + mrtrix_header_size;
+      zs.avail_out = member.size() - mrtrix_header_size - trailer_size;
+      const int status = ::deflate (&zs, Z_FINISH);
+      const size_t compressed_size = zs.total_out;
+      deflateEnd (&zs);
+      if (status != Z_STREAM_END)
+        throw Exception ("error compressing data: " + str (zs.msg ? zs.msg : "unknown zlib error"));
+
+      const size_t member_size = mrtrix_header_size + compressed_size + trailer_size;
+      member.resize (member_size);
+
+      const uint8_t head[] = {
+        0x1f, 0x8b, Z_DEFLATED, FEXTRA, // magic number, compression method & flags
+        0, 0, 0, 0,                     // modification time (not set)
+        0, 3,                           // extra flags & OS (Unix)
+        8, 0,                           // length of extra field
+        'M', 'R', 4, 0                  // subfield ID & length
+      };
+      memcpy (member.data(), head, sizeof (head));
+      Raw::store_LE<uint32_t> (member_size, member.data() + sizeof (head));
+      Raw::store_LE<uint32_t> (crc32 (0, data, size), member.data() + member_size - 8);
+      Raw::store_LE<uint32_t> (size, member.data() + member_size - 4);
+    }
+
+
+
+    void GZMember::inflate (const uint8_t* member, uint8_t* data) const
+    {
+      const size_t header_size = fixed_header_size + Raw::fetch_LE<uint16_t> (member + 10);
+
+      z_stream zs;
+      memset (&zs, 0, sizeof (zs));
+      if (inflateInit2 (&zs, -MAX_WBITS) != Z_OK)
+        throw Exception ("error initialising zlib decompression");
+
+      zs.next_in = const_cast<Bytef*> (member + header_size);
+      zs.avail_in = size - header_size - trailer_size;
+      zs.next_out = data;
+      zs.avail_out = data_size;
+      const int status = ::inflate (&zs, Z_FINISH);
+      const size_t uncompressed_size = zs.total_out;
+      inflateEnd (&zs);
+
+      if (status != Z_STREAM_END || uncompressed_size != data_size)
+        throw Exception ("error uncompressing gzip member at offset " + str (offset) + ": "
+            + str (zs.msg ? zs.msg : "unexpected member size"));
+      if (crc32 (0, data, data_size) != Raw::fetch_LE<uint32_t> (member + size - 8))
+        throw Exception ("CRC error uncompressing gzip member at offset " + str (offset));
+    }
+
+
+  }
+}
+
@@ -0,0 +1,69 @@
+/*
+ * Copyright (c) 2008-2018 the MRtrix3 contributors.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at http://mozilla.org/MPL/2.0/
+ *
+ * MRtrix3 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * For more details, see http://www.mrtrix.org/
+ */
+
+
+#ifndef __file_gz_members_h__
+#define __file_gz_members_h__
+
+#include <cstdint>
+
+#include "types.h"
+
+namespace MR
+{
+  namespace File
+  {
+
+    //! a single independently compressed member of a gzip file
+    /*! The gzip format (RFC 1952) allows a file to consist of any number of
+     * concatenated members, which any conforming decoder will read back as
+     * a single stream. MRtrix3 writes compressed images as a series of such
+     * members, each tagged in its header with an 'MR' extra subfield holding
+     * the total compressed size of the member. This allows the members to be
+     * located without inflating the file, and to be inflated in parallel.
+     * Files written by \c bgzip (tagged with a 'BC' subfield) are also
+     * recognised. */
+    class GZMember { NOMEMALIGN
+      public:
+        //! the byte offset of the member within the compressed file
+        int64_t offset;
+        //! the total size of the member within the compressed file
+        size_t size;
+        //! the byte offset of the member contents within the uncompressed stream
+        int64_t data_offset;
+        //! the size of the member contents once uncompressed
+        size_t data_size;
+
+        //! compress \a size bytes from \a data into a single tagged gzip member
+        static void deflate (const uint8_t* data, size_t size, vector<uint8_t>& member);
+
+        //! uncompress the member held in \a member into \a data
+        /*! \a member should hold the entire compressed member, as read from
+         * file from position \a offset, and \a data should be large enough
+         * to hold \a data_size bytes. */
+        void inflate (const uint8_t* member, uint8_t* data) const;
+    };
+
+
+    //! locate all members in the gzip file \a filename
+    /*! Returns an empty list if any of the members in the file are not
+     * tagged with their compressed size; in this case the file can only
+     * be read sequentially. */
+    vector<GZMember> scan_gz_members (const std::string& filename);
+
+  }
+}
+
+#endif
+
@@ -43,8 +43,42 @@ namespace MR
   namespace File
   {
 
+    namespace
+    {
+#ifndef MRTRIX_WINDOWS
+      // whether the filesystem is networked, based on the f_type reported by statfs():
+      bool is_networked (const struct statfs& fsbuf)
+      {
+        return fsbuf.f_type == 0xff534d42 /* CIFS */|| fsbuf.f_type == 0x6969 /* NFS */ ||
+            fsbuf.f_type == 0x65735546 /* FUSE */ || fsbuf.f_type == 0x517b /* SMB */ ||
+            fsbuf.f_type == 0x47504653 /* GPFS */ || fsbuf.f_type == 0xbd00bd0 /* LUSTRE */
+
+#ifdef MRTRIX_MACOSX
+            || fsbuf.f_type == 0x0017 /* OSXFUSE */
+#endif
+            ;
+      }
+#endif
+    }
+
+
+
+    bool is_networked (const std::string& path)
+    {
+#ifdef MRTRIX_WINDOWS
+      const unsigned int length = 255;
+      char root_path[length];
+      return GetVolumePathName (path.c_str(), root_path, length) && GetDriveType (root_path) == 4; // DRIVE_REMOTE
+#else
+      struct statfs fsbuf;
+      return !statfs (path.c_str(), &fsbuf) && is_networked (fsbuf);
+#endif
+    }
+
+
+
     MMap::MMap (const Entry& entry, bool readwrite, bool preload, int64_t mapped_size) :
-      Entry (entry), addr (NULL), first (NULL), msize (mapped_size), readwrite (readwrite)
+      Entry (entry), addr (NULL), first (NULL), msize (mapped_size), readwrite (readwrite), stop_prefetch (false)
     {
       DEBUG ("memory-mapping file \"" + Entry::name + "\"...");
 
@@ -110,15 +144,7 @@ namespace MR
           DEBUG ("  defaulting to delayed write-back");
           delayed_writeback = true;
         }
-
-        if (fsbuf.f_type == 0xff534d42 /* CIFS */|| fsbuf.f_type == 0x6969 /* NFS */ || 
-            fsbuf.f_type == 0x65735546 /* FUSE */ || fsbuf.f_type == 0x517b /* SMB */ || 
-            fsbuf.f_type == 0x47504653 /* GPFS */ || fsbuf.f_type == 0xbd00bd0 /* LUSTRE */
-
-#ifdef MRTRIX_MACOSX
-            || fsbuf.f_type == 0x0017 /* OSXFUSE */
-#endif 
-        ) {
+        else if (is_networked (fsbuf)) {
           DEBUG ("\"" + Entry::name + "\" appears to reside on a networked filesystem - using delayed write-back");
           delayed_writeback = true;
         }
@@ -187,6 +213,10 @@ namespace MR
 
     MMap::~MMap()
     {
+      if (prefetch_thread.joinable()) {
+        stop_prefetch = true;
+        prefetch_thread.join();
+      }
       if (!first) return;
       if (addr) {
         DEBUG ("unmapping file \"" + Entry::name + "\"");
@@ -239,6 +269,88 @@ namespace MR
 
 
 
+
+    void MMap::advise (Access pattern)
+    {
+      if (!addr)
+        return;
+#ifndef MRTRIX_WINDOWS
+      int madv = MADV_NORMAL;
+      switch (pattern) {
+        case Access::Sequential: madv = MADV_SEQUENTIAL; break;
+        case Access::Random: madv = MADV_RANDOM; break;
+        default: break;
+      }
+      if (madvise (addr, start + msize, madv))
+        DEBUG ("madvise() failed for file \"" + Entry::name + "\": " + strerror (errno));
+# ifdef POSIX_FADV_NORMAL
+      int fadv = POSIX_FADV_NORMAL;
+      switch (pattern) {
+        case Access::Sequential: fadv = POSIX_FADV_SEQUENTIAL; break;
+        case Access::Random: fadv = POSIX_FADV_RANDOM; break;
+        default: break;
+      }
+      posix_fadvise (fd, start, msize, fadv);
+# endif
+#else
+      (void) pattern;
+#endif
+    }
+
+
+
+
+
+    void MMap::prefetch (const vector<std::pair<int64_t,int64_t>>& ranges)
+    {
+      if (!addr || prefetch_thread.joinable())
+        return;
+
+      const int64_t page_size = 4096;
+      vector<std::pair<int64_t,int64_t>> regions;
+      for (const auto& r : ranges) {
+        const int64_t first_byte = std::max<int64_t> (0, r.first), last_byte = std::min (msize, r.second);
+        if (last_byte > first_byte)
+          regions.push_back ({ first_byte, last_byte });
+      }
+      if (regions.empty())
+        return;
+
+#ifndef MRTRIX_WINDOWS
+      for (const auto& r : regions) {
+        // madvise() requires a page-aligned address:
+        const int64_t offset = ((start + r.first) / page_size) * page_size;
+        madvise (addr + offset, start + r.second - offset, MADV_WILLNEED);
+      }
+#endif
+
+      //CONF option: MMapPrefetch
+      //CONF default: 1 (true)
+      //CONF Whether to use a background thread to read in those parts of
+      //CONF memory-mapped image files that are expected to be accessed
+      //CONF (i.e. the whole image for sequential processing, or only the
+      //CONF relevant volumes where a subset is to be processed), for files
+      //CONF residing on networked filesystems (e.g. NFS, Lustre, GPFS). This
+      //CONF allows processing to proceed while the data are being fetched,
+      //CONF rather than stalling on each page fault.
+      static const bool prefetch_enabled = File::Config::get_bool ("MMapPrefetch", true);
+      if (!prefetch_enabled || !is_networked (Entry::name))
+        return;
+
+      DEBUG ("prefetching contents of file \"" + Entry::name + "\" in background");
+      const uint8_t* data = first;
+      prefetch_thread = std::thread ([this,data,regions,page_size] () {
+          volatile uint8_t sink = 0;
+          for (const auto& r : regions)
+            for (int64_t n = r.first; n < r.second && !stop_prefetch; n += page_size)
+              sink += data[n];
+          (void) sink;
+      });
+    }
+
+
+
+
   }
 }
 
@@ -19,6 +19,8 @@
 #include <iostream>
 #include <cassert>
 #include <cstdint>
+#include <atomic>
+#include <thread>
 
 #include "types.h"
 #include "file/entry.h"
@@ -28,8 +30,26 @@ namespace MR
   namespace File
   {
 
+    //! whether \a path resides on a networked filesystem
+    /*! Files on such filesystems are not memory-mapped for read-write
+     * access, but held in a RAM buffer instead (see MMap::MMap()). */
+    bool is_networked (const std::string& path);
+
+
+
     class MMap : protected Entry { NOMEMALIGN
       public:
+        //! the expected pattern of access to the mapped data
+        /*! - \c Normal: no particular pattern (the system default);
+         * - \c Sequential: the data will be accessed mostly in the order in
+         *   which they are stored (e.g. when processed using a ThreadedLoop
+         *   along the image strides);
+         * - \c Random: the data will be accessed at random locations
+         *   (e.g. when interpolating during streamline tracking), so that
+         *   readahead would be wasteful.
+         * \sa advise() */
+        enum class Access { Normal, Sequential, Random };
+
         //! create a new memory-mapping to file in \a entry
         /*! map file in \a entry at the offset in \a entry. By default, the
          * file will be mapped read-only. If \a readwrite is set to true,
@@ -72,6 +92,25 @@ namespace MR
         }
         bool changed () const;
 
+        //! advise the system of the expected pattern of access to the data
+        /*! This sets the readahead policy for the mapped region, via
+         * madvise() and posix_fadvise() where available. It has no effect if
+         * the contents of the file are held in a RAM buffer (see the
+         * constructor). */
+        void advise (Access pattern);
+
+        //! start loading the regions \a ranges of the data into RAM
+        /*! Each range is a [first,last) pair of byte offsets relative to the
+         * start of the mapped region. The system is asked to read these
+         * regions in ahead of time; in addition, if the file resides on a
+         * networked filesystem (where page faults are particularly
+         * expensive), a background thread is launched to read them in
+         * explicitly, so that processing can proceed concurrently with IO
+         * (see the MMapPrefetch config file option). This returns
+         * immediately; any outstanding prefetching is abandoned when the
+         * mapping is destroyed. */
+        void prefetch (const vector<std::pair<int64_t,int64_t>>& ranges);
+
         friend std::ostream& operator<< (std::ostream& stream, const MMap& m) {
           stream << "File::MMap { " << m.name() << " [" << m.fd << "], size: "
                  << m.size() << ", mapped " << (m.readwrite ? "RW" : "RO")
@@ -86,11 +125,13 @@ namespace MR
         int64_t   msize;       /**< The size of the file. */
         time_t    mtime;       /**< The modification time of the file at the last check. */
         bool      readwrite;
+        std::thread prefetch_thread;
+        std::atomic<bool> stop_prefetch;
 
         void map ();
 
       private:
-        MMap (const MMap& mmap) : Entry (mmap), fd (0), addr (NULL), first (NULL), msize (0), mtime (0), readwrite (false) {
+        MMap (const MMap& mmap) : Entry (mmap), fd (0), addr (NULL), first (NULL), msize (0), mtime (0), readwrite (false), stop_prefetch (false) {
           assert (0);
         }
     };
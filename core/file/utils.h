@@ -173,11 +173,11 @@ namespace MR
 
 
 
-    inline std::string create_tempfile (int64_t size = 0, const char* suffix = NULL)
+    inline std::string create_tempfile (int64_t size = 0, const char* suffix = NULL, const std::string& dir = tmpfile_dir())
     {
-      DEBUG ("creating temporary file of size " + str (size));
+      DEBUG ("creating temporary file of size " + str (size) + " in directory \"" + dir + "\"");
 
-      std::string filename (Path::join (tmpfile_dir(), tmpfile_prefix()) + "XXXXXX.");
+      std::string filename (Path::join (dir, tmpfile_prefix()) + "XXXXXX.");
       int rand_index = filename.size() - 7;
       if (suffix) filename += suffix;
 
@@ -189,7 +189,7 @@ namespace MR
       } while (fid < 0 && errno == EEXIST);
 
       if (fid < 0)
-        throw Exception (std::string ("error creating temporary file in directory \"" + tmpfile_dir() + "\": ") + strerror (errno));
+        throw Exception (std::string ("error creating temporary file in directory \"" + dir + "\": ") + strerror (errno));
 
 
 
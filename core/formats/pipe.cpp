@@ -59,7 +59,7 @@ namespace MR
       if (H.name() != "-")
         return false;
 
-      H.name() = File::create_tempfile (0, "mif");
+      H.name() = File::create_tempfile (0, "mif", ImageIO::Pipe::tmpfile_dir (footprint (H)));
 
       SignalHandler::mark_file_for_deletion (H.name());
 
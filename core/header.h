@@ -290,6 +290,36 @@ namespace MR
       void reset_intensity_scaling () { set_intensity_scaling (); }
 
       bool is_file_backed () const { return valid() ? io->is_file_backed() : false; }
+      //! the number of files over which the image data are stored
+      size_t num_files () const { return valid() ? io->files.size() : 0; }
+
+      //! hint that only positions \a indices along \a axis will be accessed
+      /*! This allows the image data to be loaded only partially where this
+       * is beneficial (e.g. for compressed images, only the relevant
+       * portions of the file need to be uncompressed). It must be invoked
+       * before get_image(); values at any other positions along \a axis
+       * will then be undefined. See ImageIO::Base::set_access_indices(). */
+      void set_access_indices (size_t axis, const vector<int>& indices) {
+        if (valid())
+          io->set_access_indices (axis, indices);
+      }
+
+      //! hint at the expected pattern of access to the image data
+      /*! This must be invoked before get_image(). See
+       * ImageIO::Base::set_access_pattern(). */
+      void set_access_pattern (File::MMap::Access pattern) {
+        if (valid())
+          io->set_access_pattern (pattern);
+      }
+
+      //! allow access to the volumes of a streamed image as they become available
+      /*! This must be invoked before get_image(), and only if the caller
+       * will then invoke Image::wait_for_volumes() before accessing each
+       * volume. See ImageIO::Base::set_streaming(). */
+      void set_streaming (bool enable = true) {
+        if (valid())
+          io->set_streaming (enable);
+      }
 
       //! make header self-consistent
       void sanitise () {
@@ -82,14 +82,24 @@ namespace MR
 
         FORCE_INLINE bool is_direct_io () const { return data_pointer; }
 
+        //! whether this image is being streamed volume by volume through a pipe
+        bool is_streamed () const { return buffer->get_io() && buffer->get_io()->is_streamed(); }
+        //! for streamed images: wait until the first \a num volumes are available
+        /*! \sa Header::set_streaming() */
+        void wait_for_volumes (size_t num) const { if (buffer->get_io()) buffer->get_io()->wait_for_volumes (num); }
+        //! for streamed images: signal that the first \a num volumes have been written
+        void publish_volumes (size_t num) const { if (buffer->get_io()) buffer->get_io()->publish_volumes (num); }
+
         //! get voxel value at current location
       FORCE_INLINE ValueType get_value () const {
           if (data_pointer) return Raw::fetch_native<ValueType> (data_pointer, data_offset);
+          if (fast_path != FetchStoreFastPath::None) return __fetch_fast<ValueType> (fast_path, io_pointer, data_offset, io_offset, io_scale);
           return buffer->get_value (data_offset);
         }
       //! set voxel value at current location
         FORCE_INLINE void set_value (ValueType val) {
           if (data_pointer) Raw::store_native<ValueType> (val, data_pointer, data_offset);
+          else if (fast_path != FetchStoreFastPath::None) __store_fast<ValueType> (val, fast_path, io_pointer, data_offset, io_offset, io_scale);
           else buffer->set_value (data_offset, val);
         }
 
@@ -102,7 +112,7 @@ namespace MR
             stream << "outside FoV";
           else
             stream << "value = " << V.value();
-          if (!V.data_pointer) stream << " (using indirect IO)";
+          if (!V.data_pointer) stream << " (using indirect IO" << ( V.fast_path != FetchStoreFastPath::None ? ", inline conversion)" : ")" );
           else stream << " (using direct IO, data at " << V.data_pointer << ")";
           return stream;
         }
@@ -176,6 +186,16 @@ namespace MR
               Stride::contiguous_along_axis (axis, *buffer) );
         }
 
+        //! whether with_direct_io() would preload the data of \a header into RAM
+        /*! This allows the caller to determine, before invoking get_image(),
+         * whether the data will be accessed in place (e.g. to set an
+         * appropriate access pattern using Header::set_access_pattern()). */
+        static bool preload_required (const Header& header, const Stride::List& with_strides = Stride::List()) {
+          if (header.datatype() != DataType::from<ValueType>() || header.num_files() > 1)
+            return true;
+          return with_strides.size() && Stride::get_actual (Stride::get_nearest_match (header, with_strides), header) != Stride::get (header);
+        }
+
 
         //! return RAM address of current voxel
         /*! \note this will only work if image access is direct (i.e. for a
@@ -200,6 +220,10 @@ namespace MR
       protected:
         //! pointer to data address whether in RAM or MMap
         void* data_pointer;
+        //! for indirect IO using inline conversion: address & scaling of the data
+        void* io_pointer;
+        default_type io_offset, io_scale;
+        FetchStoreFastPath fast_path;
         //! voxel indices
         vector<ssize_t> x;
         //! voxel indices
@@ -225,7 +249,7 @@ namespace MR
         Buffer& operator= (const Buffer&) = delete;
         Buffer& operator= (Buffer&&) = default;
         Buffer (const Buffer& b) : 
-          Header (b), fetch_func (b.fetch_func), store_func (b.store_func) { }
+          Header (b), fetch_func (b.fetch_func), store_func (b.store_func), fast_path (b.fast_path) { }
 
 
         FORCE_INLINE ValueType get_value (size_t offset) const {
@@ -238,17 +262,72 @@ namespace MR
           store_func (val, io->segment (nseg), offset - nseg*io->segment_size(), intensity_offset(), intensity_scale());
         }
 
+        //! fetch \a num values spaced \a stride apart, starting from \a offset
+        /*! The segment is looked up only once if all values lie within it. */
+        void get_values (ValueType* values, size_t offset, ssize_t stride, size_t num) const {
+          const size_t last = offset + (num-1) * stride;
+          const size_t nseg = offset / io->segment_size();
+          if (!num || last / io->segment_size() != nseg) {
+            for (size_t n = 0; n < num; ++n)
+              values[n] = get_value (offset + n*stride);
+            return;
+          }
+          const void* segment = io->segment (nseg);
+          offset -= nseg*io->segment_size();
+          const FetchStoreFastPath path = get_fast_path();
+          if (path != FetchStoreFastPath::None) {
+            for (size_t n = 0; n < num; ++n)
+              values[n] = __fetch_fast<ValueType> (path, segment, offset + n*stride, intensity_offset(), intensity_scale());
+          }
+          else {
+            for (size_t n = 0; n < num; ++n)
+              values[n] = fetch_func (segment, offset + n*stride, intensity_offset(), intensity_scale());
+          }
+        }
+
+        //! store \a num values spaced \a stride apart, starting from \a offset
+        /*! The segment is looked up only once if all values lie within it. */
+        void set_values (const ValueType* values, size_t offset, ssize_t stride, size_t num) const {
+          const size_t last = offset + (num-1) * stride;
+          const size_t nseg = offset / io->segment_size();
+          if (!num || last / io->segment_size() != nseg) {
+            for (size_t n = 0; n < num; ++n)
+              set_value (offset + n*stride, values[n]);
+            return;
+          }
+          void* segment = io->segment (nseg);
+          offset -= nseg*io->segment_size();
+          const FetchStoreFastPath path = get_fast_path();
+          if (path != FetchStoreFastPath::None) {
+            for (size_t n = 0; n < num; ++n)
+              __store_fast<ValueType> (values[n], path, segment, offset + n*stride, intensity_offset(), intensity_scale());
+          }
+          else {
+            for (size_t n = 0; n < num; ++n)
+              store_func (values[n], segment, offset + n*stride, intensity_offset(), intensity_scale());
+          }
+        }
+
         std::unique_ptr<uint8_t[]> data_buffer;
+        MemoryUsage::Allocation data_buffer_memory;
         void* get_data_pointer ();
 
         FORCE_INLINE ImageIO::Base* get_io () const { return io.get(); }
 
+        //! the inline conversion to use for indirect IO, if any
+        /*! This is only available if the data are held in a single segment. */
+        FORCE_INLINE FetchStoreFastPath get_fast_path () const {
+          return io && io->is_file_backed() && io->nsegments() == 1 ? fast_path : FetchStoreFastPath::None;
+        }
+
       protected:
         std::function<ValueType(const void*,size_t,default_type,default_type)> fetch_func;
         std::function<void(ValueType,void*,size_t,default_type,default_type)> store_func;
+        FetchStoreFastPath fast_path = FetchStoreFastPath::None;
 
         void set_fetch_store_functions () {
           __set_fetch_store_functions (fetch_func, store_func, datatype());
+          fast_path = __fetch_store_fast_path<ValueType> (datatype());
         }
     };
 
@@ -367,20 +446,30 @@ namespace MR
   template <typename ValueType>
     FORCE_INLINE Image<ValueType>::Image () :
       data_pointer (nullptr), 
+      io_pointer (nullptr),
+      io_offset (0.0),
+      io_scale (1.0),
+      fast_path (FetchStoreFastPath::None),
       data_offset (0) { }
 
   template <typename ValueType>
     Image<ValueType>::Image (const std::shared_ptr<Image<ValueType>::Buffer>& buffer_p, const Stride::List& desired_strides) :
       buffer (buffer_p),
       data_pointer (buffer->get_data_pointer()),
+      io_pointer (nullptr),
+      io_offset (buffer->intensity_offset()),
+      io_scale (buffer->intensity_scale()),
+      fast_path (data_pointer ? FetchStoreFastPath::None : buffer->get_fast_path()),
       x (ndim(), 0),
       strides (desired_strides.size() ? desired_strides : Stride::get (*buffer)),
       data_offset (Stride::offset (*this))
       { 
         assert (buffer);
         assert (data_pointer || buffer->get_io());
+        if (fast_path != FetchStoreFastPath::None)
+          io_pointer = buffer->get_io()->segment (0);
         DEBUG ("image \"" + name() + "\" initialised with strides = " + str(strides) + ", start = " + str(data_offset) 
-            + ", using " + ( is_direct_io() ? "" : "in" ) + "direct IO");
+            + ", using " + ( is_direct_io() ? "" : "in" ) + "direct IO" + ( fast_path != FetchStoreFastPath::None ? " with inline conversion" : "" ));
       }
 
 
@@ -395,6 +484,7 @@ namespace MR
         if (buffer->get_io()) {
           if (buffer->get_io()->is_image_readwrite() && buffer->data_buffer) {
             auto data_buffer = std::move (buffer->data_buffer);
+            auto data_buffer_memory = std::move (buffer->data_buffer_memory);
             TmpImage<ValueType> src = { *buffer, data_buffer.get(), vector<ssize_t> (ndim(), 0), strides, Stride::offset (*this) };
             Image<ValueType> dest (buffer);
             threaded_copy_with_progress_message ("writing back direct IO buffer for \"" + name() + "\"", src, dest); 
@@ -415,12 +505,9 @@ namespace MR
       if (!buffer.unique())
         throw Exception ("FIXME: don't invoke 'with_direct_io()' on images if other copies exist!");
 
-      bool preload = ( buffer->datatype() != DataType::from<ValueType>() ) || ( buffer->get_io()->files.size() > 1 );
-      if (with_strides.size()) {
-        auto new_strides = Stride::get_actual (Stride::get_nearest_match (*this, with_strides), *this);
-        preload |= ( new_strides != Stride::get (*this) );
-        with_strides = new_strides;
-      }
+      const bool preload = preload_required (*buffer, with_strides);
+      if (with_strides.size())
+        with_strides = Stride::get_actual (Stride::get_nearest_match (*this, with_strides), *this);
       else 
         with_strides = Stride::get (*this); 
 
@@ -432,12 +519,15 @@ namespace MR
       // the buffer into which to copy the data:
       const auto buffer_size = footprint<ValueType> (voxel_count (*this));
       buffer->data_buffer = std::unique_ptr<uint8_t[]> (new uint8_t [buffer_size]);
+      buffer->data_buffer_memory = MemoryUsage::Allocation (buffer_size);
 
       if (buffer->get_io()->is_image_new()) {
         // no need to preload if data is zero anyway:
         memset (buffer->data_buffer.get(), 0, buffer_size);
       }
       else {
+        if (ndim() > 3)
+          wait_for_volumes (size (3));
         auto src (*this);
         TmpImage<ValueType> dest = { *buffer, buffer->data_buffer.get(), vector<ssize_t> (ndim(), 0), with_strides, Stride::offset (with_strides, *this) };
         threaded_copy_with_progress_message ("preloading data for \"" + name() + "\"", src, dest); 
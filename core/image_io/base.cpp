@@ -15,6 +15,7 @@
 
 #include "image_io/base.h"
 #include "header.h"
+#include "stride.h"
 
 namespace MR
 {
@@ -25,7 +26,9 @@ namespace MR
     Base::Base (const Header& header) : 
       segsize (voxel_count (header)),
       is_new (false),
-      writable (false) { }
+      writable (false),
+      streaming (false),
+      access_pattern (File::MMap::Access::Normal) { }
 
 
     Base::~Base () { }
@@ -52,6 +55,61 @@ namespace MR
       unload (header);
       DEBUG ("image \"" + header.name() + "\" unloaded");
       addresses.clear();
+      memory.reset();
+    }
+
+
+
+    vector<std::pair<int64_t,int64_t>> Base::access_ranges (const Header& header) const
+    {
+      const int64_t bits = header.datatype().bits();
+      const int64_t total = (bits * voxel_count (header) + 7) / 8;
+
+      // only the outermost axis (i.e. that with the largest stride) will map
+      // each position onto a single contiguous region of the data:
+      const auto strides = Stride::get_actual (header);
+      const size_t axis = Stride::order (strides).back();
+      if (axis >= access_indices.size() || access_indices[axis].empty() || header.size (axis) < 2)
+        return { { 0, total } };
+
+      const int64_t block = bits * std::abs (strides[axis]);
+      vector<int> indices (access_indices[axis]);
+      for (auto& i : indices) {
+        if (i < 0 || i >= header.size (axis))
+          return { { 0, total } };
+        if (strides[axis] < 0)
+          i = header.size (axis) - 1 - i;
+      }
+      std::sort (indices.begin(), indices.end());
+
+      vector<std::pair<int64_t,int64_t>> ranges;
+      for (const auto i : indices) {
+        const int64_t first = (i * block) / 8, last = ((i+1) * block + 7) / 8;
+        if (ranges.size() && first <= ranges.back().second)
+          ranges.back().second = std::max (ranges.back().second, last);
+        else
+          ranges.push_back ({ first, last });
+      }
+      return ranges;
+    }
+
+
+
+    void Base::advise (const Header& header, File::MMap& mmap, int64_t offset) const
+    {
+      if (is_new)
+        return;
+      mmap.advise (access_pattern);
+
+      const auto ranges = access_ranges (header);
+      const bool whole = ranges.size() == 1 && ranges[0].first == 0 && ranges[0].second >= offset + mmap.size();
+      if (whole && access_pattern != File::MMap::Access::Sequential)
+        return;
+
+      vector<std::pair<int64_t,int64_t>> local;
+      for (const auto& r : ranges)
+        local.push_back ({ r.first - offset, r.second - offset });
+      mmap.prefetch (local);
     }
 
 
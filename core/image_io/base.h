@@ -21,9 +21,11 @@
 #include <unistd.h>
 
 #include "memory.h"
+#include "memory_usage.h"
 #include "mrtrix.h"
 #include "types.h"
 #include "file/entry.h"
+#include "file/mmap.h"
 
 #define MAX_FILES_PER_IMAGE 256U
 
@@ -58,6 +60,51 @@ namespace MR
         void open (const Header& header, size_t buffer_size = 0);
         void close (const Header& header);
 
+        //! hint that only positions \a indices along \a axis will be accessed
+        /*! Handlers that need to load the image data into RAM (e.g. for
+         * compressed images) can use this information to load only those
+         * portions of the data that will actually be accessed. This must be
+         * set before the image is opened; values at any other positions
+         * along \a axis will be undefined. */
+        void set_access_indices (size_t axis, const vector<int>& indices) {
+          assert (addresses.empty());
+          if (access_indices.size() <= axis)
+            access_indices.resize (axis+1);
+          access_indices[axis] = indices;
+        }
+
+        //! hint at the expected pattern of access to the image data
+        /*! Handlers that memory-map the image files will pass this on to the
+         * system to set the readahead policy (see File::MMap::advise()). In
+         * addition, if the pattern is File::MMap::Access::Sequential, or
+         * if hints have been provided using set_access_indices(), the
+         * relevant portions of the data are prefetched (see
+         * File::MMap::prefetch()). This must be set before the image is
+         * opened. */
+        void set_access_pattern (File::MMap::Access pattern) {
+          assert (addresses.empty());
+          access_pattern = pattern;
+        }
+
+        //! allow access to volumes of a streamed image as they become available
+        /*! Images passed between commands via a pipe may be streamed one
+         * volume at a time (see ImageIO::Pipe). By default, opening such an
+         * image waits until all of its volumes are complete. If streaming is
+         * enabled before the image is opened, the image is instead made
+         * available immediately; the caller must then invoke
+         * wait_for_volumes() before accessing each volume. */
+        void set_streaming (bool enable) {
+          assert (addresses.empty());
+          streaming = enable;
+        }
+
+        //! whether volumes of this image are being streamed through a pipe
+        virtual bool is_streamed () const { return false; }
+        //! wait until the first \a num volumes of a streamed image are available
+        virtual void wait_for_volumes (size_t /*num*/) { }
+        //! signal that the first \a num volumes of an image being written are complete
+        virtual void publish_volumes (size_t /*num*/) { }
+
         bool is_image_new () const { return is_new; }
         bool is_image_readwrite () const { return writable; }
 
@@ -102,7 +149,26 @@ namespace MR
       protected:
         size_t segsize;
         vector<std::unique_ptr<uint8_t[]>> addresses;
-        bool is_new, writable;
+        //! registers any image data held in RAM (see MemoryUsage)
+        /*! Handlers that allocate memory for the image data in load() should
+         * set this accordingly; it is reset once the image is closed. */
+        MemoryUsage::Allocation memory;
+        bool is_new, writable, streaming;
+        vector<vector<int>> access_indices;
+        File::MMap::Access access_pattern;
+
+        //! the byte ranges of the image data that are expected to be accessed
+        /*! These are computed from the hints provided via
+         * set_access_indices(), as [first,last) pairs of byte offsets relative
+         * to the start of the (concatenated) image data. If no hints were
+         * provided, or if they do not map onto contiguous regions of the
+         * data, a single range spanning the entire data is returned. */
+        vector<std::pair<int64_t,int64_t>> access_ranges (const Header& header) const;
+
+        //! pass the access hints on to the memory-mapping \a mmap
+        /*! \a offset is the position of the start of the mapped region
+         * relative to the start of the (concatenated) image data. */
+        void advise (const Header& header, File::MMap& mmap, int64_t offset = 0) const;
 
         void check () const {
           assert (addresses.size());
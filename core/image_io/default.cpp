@@ -82,6 +82,7 @@ namespace MR
       for (size_t n = 0; n < files.size(); n++) {
         mmaps[n].reset (new File::MMap (files[n], writable, !is_new, bytes_per_segment));
         addresses[n].reset (mmaps[n]->address());
+        advise (header, *mmaps[n], n * bytes_per_segment);
       }
     }
 
@@ -96,6 +97,7 @@ namespace MR
       addresses[0].reset (new uint8_t [files.size() * bytes_per_segment]);
       if (!addresses[0])
         throw Exception ("failed to allocate memory for image \"" + header.name() + "\"");
+      memory = MemoryUsage::Allocation (files.size() * bytes_per_segment);
 
       if (is_new) memset (addresses[0].get(), 0, files.size() * bytes_per_segment);
       else {
@@ -65,6 +65,101 @@ namespace MR
 #define MRTRIX_EXTERN extern
   __DEFINE_FETCH_STORE_FUNCTIONS;
 
+
+
+
+  //! on-disk datatypes for which conversion can be performed inline
+  /*! For the most commonly encountered combinations of on-disk and in-RAM
+   * datatypes, the Image class avoids the indirect call through the
+   * std::function objects set by __set_fetch_store_functions(), and instead
+   * converts values inline using __fetch_fast() and __store_fast(). This
+   * allows the conversion to be inlined into the calling loop. The path to
+   * use is selected once per image using __fetch_store_fast_path(). */
+  enum class FetchStoreFastPath : uint8_t {
+    None,
+    Int16LE, Int16BE,
+    UInt16LE, UInt16BE,
+    Float32LE, Float32BE
+  };
+
+
+  //! select the inline conversion to use for \a datatype, if any
+  template <typename ValueType>
+    inline FetchStoreFastPath __fetch_store_fast_path (DataType datatype)
+    {
+      if (!std::is_floating_point<ValueType>::value)
+        return FetchStoreFastPath::None;
+      switch (datatype()) {
+        case DataType::Int16LE: return FetchStoreFastPath::Int16LE;
+        case DataType::Int16BE: return FetchStoreFastPath::Int16BE;
+        case DataType::UInt16LE: return FetchStoreFastPath::UInt16LE;
+        case DataType::UInt16BE: return FetchStoreFastPath::UInt16BE;
+        case DataType::Float32LE: return FetchStoreFastPath::Float32LE;
+        case DataType::Float32BE: return FetchStoreFastPath::Float32BE;
+        default: return FetchStoreFastPath::None;
+      }
+    }
+
+
+
+  namespace
+  {
+    // rounding to integer storage, consistent with the generic conversion:
+    template <typename DiskType>
+      FORCE_INLINE typename std::enable_if<std::is_integral<DiskType>::value, DiskType>::type __round_to_storage (default_type val) {
+        return std::isfinite (val) ? DiskType (std::round (val)) : DiskType (0);
+      }
+
+    template <typename DiskType>
+      FORCE_INLINE typename std::enable_if<std::is_floating_point<DiskType>::value, DiskType>::type __round_to_storage (default_type val) {
+        return val;
+      }
+  }
+
+
+
+  //! fetch value \a i from \a data, using the inline conversion \a path
+  /*! \a path must not be FetchStoreFastPath::None */
+  template <typename ValueType>
+    FORCE_INLINE typename std::enable_if<std::is_floating_point<ValueType>::value, ValueType>::type __fetch_fast (FetchStoreFastPath path, const void* data, size_t i, default_type offset, default_type scale)
+    {
+      switch (path) {
+        case FetchStoreFastPath::Int16LE: return offset + scale * Raw::fetch_LE<int16_t> (data, i);
+        case FetchStoreFastPath::Int16BE: return offset + scale * Raw::fetch_BE<int16_t> (data, i);
+        case FetchStoreFastPath::UInt16LE: return offset + scale * Raw::fetch_LE<uint16_t> (data, i);
+        case FetchStoreFastPath::UInt16BE: return offset + scale * Raw::fetch_BE<uint16_t> (data, i);
+        case FetchStoreFastPath::Float32LE: return offset + scale * Raw::fetch_LE<float> (data, i);
+        default: return offset + scale * Raw::fetch_BE<float> (data, i);
+      }
+    }
+
+
+  //! store \a val as value \a i in \a data, using the inline conversion \a path
+  /*! \a path must not be FetchStoreFastPath::None */
+  template <typename ValueType>
+    FORCE_INLINE typename std::enable_if<std::is_floating_point<ValueType>::value, void>::type __store_fast (ValueType val, FetchStoreFastPath path, void* data, size_t i, default_type offset, default_type scale)
+    {
+      const default_type stored = (val - offset) / scale;
+      switch (path) {
+        case FetchStoreFastPath::Int16LE: Raw::store_LE<int16_t> (__round_to_storage<int16_t> (stored), data, i); return;
+        case FetchStoreFastPath::Int16BE: Raw::store_BE<int16_t> (__round_to_storage<int16_t> (stored), data, i); return;
+        case FetchStoreFastPath::UInt16LE: Raw::store_LE<uint16_t> (__round_to_storage<uint16_t> (stored), data, i); return;
+        case FetchStoreFastPath::UInt16BE: Raw::store_BE<uint16_t> (__round_to_storage<uint16_t> (stored), data, i); return;
+        case FetchStoreFastPath::Float32LE: Raw::store_LE<float> (__round_to_storage<float> (stored), data, i); return;
+        default: Raw::store_BE<float> (__round_to_storage<float> (stored), data, i); return;
+      }
+    }
+
+
+  // never invoked: the inline conversions are only selected for floating-point types
+  template <typename ValueType>
+    FORCE_INLINE typename std::enable_if<!std::is_floating_point<ValueType>::value, ValueType>::type __fetch_fast (
+        FetchStoreFastPath, const void*, size_t, default_type, default_type) { assert (0); return ValueType(); }
+
+  template <typename ValueType>
+    FORCE_INLINE typename std::enable_if<!std::is_floating_point<ValueType>::value, void>::type __store_fast (
+        ValueType, FetchStoreFastPath, void*, size_t, default_type, default_type) { assert (0); }
+
 }
 
 #endif
@@ -14,20 +14,307 @@
 
 
 #include <limits>
+#include <fstream>
+#include <mutex>
 
 #include "app.h"
 #include "progressbar.h"
 #include "header.h"
+#include "thread.h"
 #include "image_io/gz.h"
 #include "file/gz.h"
+#include "file/config.h"
+#include "file/gz_index.h"
+#include "file/gz_members.h"
 
 #define BYTES_PER_ZCALL 524288
+#define BYTES_PER_ZMEMBER 4194304
 
 namespace MR
 {
   namespace ImageIO
   {
 
+    namespace {
+
+      using Ranges = vector<std::pair<int64_t,int64_t>>;
+
+
+
+      // hands out jobs [0, num_jobs) to multiple threads, updating the
+      // progress bar as the corresponding data are uncompressed:
+      class JobQueue { NOMEMALIGN
+        public:
+          JobQueue (size_t num_jobs, ProgressBar& progress) :
+            num_jobs (num_jobs), next (0), bytes (0), ticks (0), progress (progress) { }
+
+          bool get (size_t& job, int64_t bytes_done) {
+            std::lock_guard<std::mutex> lock (mutex);
+            bytes += bytes_done;
+            for (; ticks < bytes / BYTES_PER_ZCALL; ++ticks)
+              ++progress;
+            if (next >= num_jobs)
+              return false;
+            job = next++;
+            return true;
+          }
+
+        protected:
+          const size_t num_jobs;
+          size_t next;
+          int64_t bytes, ticks;
+          ProgressBar& progress;
+          std::mutex mutex;
+      };
+
+      template <class Functor>
+        inline void run_jobs (Functor& functor)
+        {
+          if (Thread::number_of_threads() > 1)
+            Thread::run (Thread::multi (functor), "GZ decompression threads").wait();
+          else
+            functor.execute();
+        }
+
+
+
+      // inflate those members that overlap the regions of the uncompressed
+      // stream in ranges into data (which corresponds to offset start),
+      // using multiple threads:
+      void inflate_members (const std::string& filename, const vector<File::GZMember>& all_members,
+          const Ranges& ranges, int64_t start, uint8_t* data, ProgressBar& progress)
+      {
+        vector<const File::GZMember*> members;
+        for (const auto& m : all_members)
+          for (const auto& r : ranges)
+            if (m.data_offset < r.second && m.data_offset + int64_t (m.data_size) > r.first) {
+              members.push_back (&m);
+              break;
+            }
+
+        JobQueue queue (members.size(), progress);
+
+        struct PerThread { NOMEMALIGN
+          JobQueue& queue;
+          const vector<const File::GZMember*>& members;
+          const std::string& filename;
+          const Ranges& ranges;
+          int64_t start;
+          uint8_t* data;
+
+          void execute () {
+            std::ifstream in (filename, std::ios::in | std::ios::binary);
+            if (!in)
+              throw Exception ("error opening file \"" + filename + "\": " + strerror (errno));
+            vector<uint8_t> compressed, buffer;
+            size_t n;
+            int64_t bytes_done = 0;
+            while (queue.get (n, bytes_done)) {
+              const File::GZMember& member (*members[n]);
+              const int64_t member_end = member.data_offset + member.data_size;
+              compressed.resize (member.size);
+              in.seekg (member.offset);
+              if (!in.read (reinterpret_cast<char*> (compressed.data()), member.size))
+                throw Exception ("error reading GZ file \"" + filename + "\"");
+              bytes_done = 0;
+              for (const auto& r : ranges) {
+                if (r.first <= member.data_offset && r.second >= member_end) {
+                  member.inflate (compressed.data(), data + (member.data_offset - start));
+                  bytes_done = member.data_size;
+                  break;
+                }
+                const int64_t first = std::max (member.data_offset, r.first);
+                const int64_t last = std::min (member_end, r.second);
+                if (first >= last)
+                  continue;
+                if (buffer.size() != member.data_size) {
+                  buffer.resize (member.data_size);
+                  member.inflate (compressed.data(), buffer.data());
+                }
+                memcpy (data + (first - start), buffer.data() + (first - member.data_offset), last - first);
+                bytes_done += last - first;
+              }
+              buffer.clear();
+            }
+          }
+        } loop_thread = { queue, members, filename, ranges, start, data };
+
+        run_jobs (loop_thread);
+      }
+
+
+
+      // uncompress the regions of the uncompressed stream in ranges into
+      // data (which corresponds to offset start), using the access points in
+      // index to split the work across multiple threads:
+      void inflate_indexed (File::GZIndex& index, const Ranges& ranges, int64_t start, uint8_t* data, ProgressBar& progress)
+      {
+        // regions already covered by the index can be processed in parallel,
+        // each from its nearest access point:
+        Ranges jobs, remainder;
+        size_t p = 0;
+        for (const auto& r : ranges) {
+          int64_t first = r.first;
+          const int64_t last = std::min (r.second, index.indexed_size());
+          while (first < last) {
+            while (p < index.size() && index.position (p) <= first)
+              ++p;
+            const int64_t end = p < index.size() ? std::min (last, index.position (p)) : last;
+            jobs.push_back ({ first, end });
+            first = end;
+          }
+          if (std::max (r.first, last) < r.second)
+            remainder.push_back ({ std::max (r.first, last), r.second });
+        }
+
+        JobQueue queue (jobs.size(), progress);
+
+        struct PerThread { NOMEMALIGN
+          JobQueue& queue;
+          File::GZIndex& index;
+          const Ranges& jobs;
+          int64_t start;
+          uint8_t* data;
+
+          void execute () {
+            size_t n;
+            int64_t bytes_done = 0;
+            while (queue.get (n, bytes_done)) {
+              index.read (jobs[n].first, jobs[n].second, data + (jobs[n].first - start));
+              bytes_done = jobs[n].second - jobs[n].first;
+            }
+          }
+        } loop_thread = { queue, index, jobs, start, data };
+
+        if (jobs.size())
+          run_jobs (loop_thread);
+
+        // anything beyond the current end of the index needs to be
+        // uncompressed sequentially, extending the index as we go:
+        int64_t bytes = 0, ticks = 0;
+        for (const auto& r : remainder) {
+          index.read (r.first, r.second, data + (r.first - start), [&] (size_t bytes_done) {
+              bytes += bytes_done;
+              for (; ticks < bytes / BYTES_PER_ZCALL; ++ticks)
+                ++progress;
+              });
+        }
+      }
+
+
+
+      // load the regions of the uncompressed stream of file listed in ranges
+      // into data (which corresponds to offset file.start):
+      void load_file (const File::Entry& file, const Ranges& ranges, bool partial, uint8_t* data, ProgressBar& progress)
+      {
+        // files written as multiple tagged members can be inflated in parallel
+        // without any further information:
+        const auto members = File::scan_gz_members (file.name);
+        if (members.size() > 1 && members.back().data_offset + int64_t (members.back().data_size) >= ranges.back().second) {
+          DEBUG ("uncompressing " + str (members.size()) + " members of GZ file \"" + file.name + "\"");
+          inflate_members (file.name, members, ranges, file.start, data, progress);
+          return;
+        }
+
+        //CONF option: GZAutoSaveIndex
+        //CONF default: 0 (false)
+        //CONF A boolean value to indicate whether, when reading a compressed
+        //CONF image that was not written by MRtrix3, the index of seek points
+        //CONF built while uncompressing it should be saved alongside the image
+        //CONF (with suffix .gzidx). Subsequent commands can then uncompress
+        //CONF the file in parallel, or uncompress only those portions of it
+        //CONF that they need.
+        const bool save_index = File::Config::get_bool ("GZAutoSaveIndex", false);
+        File::GZIndex index (file.name);
+
+        if (partial || index.size() || save_index) {
+          inflate_indexed (index, ranges, file.start, data, progress);
+          if (save_index && index.modified()) {
+            try { index.save(); }
+            catch (Exception& E) {
+              INFO ("unable to save index for GZ file \"" + file.name + "\": " + E[0]);
+            }
+          }
+          return;
+        }
+
+        assert (ranges.size() == 1);
+        File::GZ zf (file.name, "rb");
+        zf.seek (ranges[0].first);
+        uint8_t* address = data;
+        uint8_t* last = data + (ranges[0].second - ranges[0].first) - BYTES_PER_ZCALL;
+        while (address < last) {
+          zf.read (reinterpret_cast<char*> (address), BYTES_PER_ZCALL);
+          address += BYTES_PER_ZCALL;
+          ++progress;
+        }
+        last += BYTES_PER_ZCALL;
+        zf.read (reinterpret_cast<char*> (address), last - address);
+      }
+
+
+
+      // compress size bytes from data as a series of independent members,
+      // using multiple threads, and write these to out in order:
+      void deflate_members (const uint8_t* data, int64_t size, std::ofstream& out, const std::string& filename, ProgressBar& progress)
+      {
+        const size_t num_members = (size + BYTES_PER_ZMEMBER - 1) / BYTES_PER_ZMEMBER;
+        const size_t num_threads = std::max (Thread::number_of_threads(), size_t (1));
+        // bound the memory used for compressed data by processing a limited
+        // number of members at a time:
+        vector<vector<uint8_t>> compressed (std::min (num_members, 4*num_threads));
+
+        struct Shared { NOMEMALIGN
+          Shared (vector<vector<uint8_t>>& compressed, ProgressBar& progress) :
+            compressed (compressed), progress (progress), first (0), next (0), end (0) { }
+          vector<vector<uint8_t>>& compressed;
+          ProgressBar& progress;
+          size_t first, next, end;
+          std::mutex mutex;
+
+          bool get (size_t& n) {
+            std::lock_guard<std::mutex> lock (mutex);
+            if (next >= end)
+              return false;
+            n = next++;
+            ++progress;
+            return true;
+          }
+        } shared (compressed, progress);
+
+        struct PerThread { NOMEMALIGN
+          Shared& shared;
+          const uint8_t* data;
+          int64_t size;
+
+          void execute () {
+            size_t n;
+            while (shared.get (n)) {
+              const int64_t offset = int64_t (n) * BYTES_PER_ZMEMBER;
+              File::GZMember::deflate (data + offset, std::min<int64_t> (BYTES_PER_ZMEMBER, size - offset),
+                  shared.compressed[n - shared.first]);
+            }
+          }
+        } loop_thread = { shared, data, size };
+
+        for (shared.first = 0; shared.first < num_members; shared.first += compressed.size()) {
+          shared.next = shared.first;
+          shared.end = std::min (shared.first + compressed.size(), num_members);
+          if (num_threads > 1)
+            Thread::run (Thread::multi (loop_thread, num_threads), "GZ compression threads").wait();
+          else
+            loop_thread.execute();
+          for (size_t n = 0; n < shared.end - shared.first; ++n)
+            out.write (reinterpret_cast<const char*> (compressed[n].data()), compressed[n].size());
+          if (!out.good())
+            throw Exception ("error writing to GZ file \"" + filename + "\": " + strerror (errno));
+        }
+      }
+
+    }
+
+
+
     void GZ::load (const Header& header, size_t)
     {
       if (files.empty())
@@ -43,24 +330,35 @@ namespace MR
       addresses[0].reset (new uint8_t [files.size() * bytes_per_segment]);
       if (!addresses[0])
         throw Exception ("failed to allocate memory for image \"" + header.name() + "\"");
+      memory = MemoryUsage::Allocation (files.size() * bytes_per_segment);
 
       if (is_new)
         memset (addresses[0].get(), 0, files.size() * bytes_per_segment);
       else {
-        ProgressBar progress ("uncompressing image \"" + header.name() + "\"",
-            files.size() * bytes_per_segment / BYTES_PER_ZCALL);
+        // if only parts of the image will be accessed, there is no need to
+        // load the rest (the corresponding memory will never be touched):
+        const auto ranges = access_ranges (header);
+        int64_t bytes_to_load = 0;
+        for (const auto& r : ranges)
+          bytes_to_load += r.second - r.first;
+        if (bytes_to_load < int64_t (files.size() * bytes_per_segment))
+          DEBUG ("loading " + str (bytes_to_load) + " of " + str (files.size() * bytes_per_segment) + " bytes of image \"" + header.name() + "\"");
+
+        ProgressBar progress ("uncompressing image \"" + header.name() + "\"", bytes_to_load / BYTES_PER_ZCALL);
         for (size_t n = 0; n < files.size(); n++) {
-          File::GZ zf (files[n].name, "rb");
-          zf.seek (files[n].start);
-          uint8_t* address = addresses[0].get() + n*bytes_per_segment;
-          uint8_t* last = address + bytes_per_segment - BYTES_PER_ZCALL;
-          while (address < last) {
-            zf.read (reinterpret_cast<char*> (address), BYTES_PER_ZCALL);
-            address += BYTES_PER_ZCALL;
-            ++progress;
+          // convert to offsets within the uncompressed stream of this file:
+          const int64_t segment_start = n * bytes_per_segment;
+          Ranges file_ranges;
+          for (const auto& r : ranges) {
+            const int64_t first = std::max (r.first, segment_start);
+            const int64_t last = std::min (r.second, segment_start + bytes_per_segment);
+            if (first < last)
+              file_ranges.push_back ({ first - segment_start + files[n].start, last - segment_start + files[n].start });
           }
-          last += BYTES_PER_ZCALL;
-          zf.read (reinterpret_cast<char*> (address), last - address);
+          if (file_ranges.empty())
+            continue;
+          const bool partial_file = file_ranges.size() > 1 || file_ranges[0].second - file_ranges[0].first < bytes_per_segment;
+          load_file (files[n], file_ranges, partial_file, addresses[0].get() + segment_start, progress);
         }
       }
 
@@ -80,24 +378,29 @@ namespace MR
         assert (addresses[0]);
 
         if (writable) {
+          // the image data are written as a series of independently
+          // compressed gzip members, so that they can be compressed (and
+          // subsequently uncompressed) in parallel - see File::GZMember
           ProgressBar progress ("compressing image \"" + header.name() + "\"",
-              files.size() * bytes_per_segment / BYTES_PER_ZCALL);
+              files.size() * ((bytes_per_segment + BYTES_PER_ZMEMBER - 1) / BYTES_PER_ZMEMBER));
+          vector<uint8_t> member;
           for (size_t n = 0; n < files.size(); n++) {
             assert (files[n].start == int64_t (lead_in_size));
-            File::GZ zf (files[n].name, "wb");
-            if (lead_in)
-              zf.write (reinterpret_cast<const char*> (lead_in.get()), lead_in_size);
-            uint8_t* address = addresses[0].get() + n*bytes_per_segment;
-            uint8_t* last = address + bytes_per_segment - BYTES_PER_ZCALL;
-            while (address < last) {
-              zf.write (reinterpret_cast<const char*> (address), BYTES_PER_ZCALL);
-              address += BYTES_PER_ZCALL;
-              ++progress;
+            std::ofstream out (files[n].name, std::ios::out | std::ios::binary | std::ios::trunc);
+            if (!out)
+              throw Exception ("error opening GZ file \"" + files[n].name + "\" for writing: " + strerror (errno));
+            if (lead_in) {
+              File::GZMember::deflate (lead_in.get(), lead_in_size, member);
+              out.write (reinterpret_cast<const char*> (member.data()), member.size());
+            }
+            deflate_members (addresses[0].get() + n*bytes_per_segment, bytes_per_segment, out, files[n].name, progress);
+            if (lead_out) {
+              File::GZMember::deflate (lead_out.get(), lead_out_size, member);
+              out.write (reinterpret_cast<const char*> (member.data()), member.size());
             }
-            last += BYTES_PER_ZCALL;
-            zf.write (reinterpret_cast<const char*> (address), last - address);
-            if (lead_out)
-              zf.write (reinterpret_cast<const char*> (lead_out.get()), lead_out_size);
+            out.close();
+            if (!out)
+              throw Exception ("error writing to GZ file \"" + files[n].name + "\": " + strerror (errno));
           }
         }
 
@@ -42,6 +42,7 @@ namespace MR
       addresses[0].reset (new uint8_t [files.size() * bytes_per_segment]);
       if (!addresses[0])
         throw Exception ("failed to allocate memory for image \"" + header.name() + "\"");
+      memory = MemoryUsage::Allocation (files.size() * bytes_per_segment);
 
       ProgressBar progress ("reformatting DICOM mosaic images", slices*files.size());
       uint8_t* data = addresses[0].get();
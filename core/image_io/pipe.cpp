@@ -15,9 +15,25 @@
 
 #include <limits>
 #include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#ifdef __linux__
+# include <sys/statvfs.h>
+#endif
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <exception>
+#include <signal.h>
+#include <thread>
 
 #include "signal_handler.h"
 #include "header.h"
+#include "raw.h"
+#include "file/config.h"
+#include "file/path.h"
+#include "file/utils.h"
 #include "image_io/pipe.h"
 
 namespace MR
@@ -25,6 +41,66 @@ namespace MR
   namespace ImageIO
   {
 
+    namespace {
+
+      // POSIX shared memory objects are held in this (tmpfs) folder on
+      // Linux, and can be accessed through it like any other file:
+      const std::string shared_memory_dir = "/dev/shm";
+
+      // space to leave free in shared memory, in addition to the image:
+      constexpr int64_t shared_memory_reserve = 64 * 1048576;
+
+      bool in_shared_memory (const std::string& filename)
+      {
+        return Path::dirname (filename) == shared_memory_dir;
+      }
+
+      // the trailer appended to streamed images holds this identifier,
+      // followed by the writer's process ID and the number of volumes
+      // written so far, each as a native 64-bit integer:
+      constexpr const char* trailer_magic = "MRSTREAM";
+
+      // the number of exceptions currently propagating:
+      inline int exceptions_in_flight ()
+      {
+#ifdef __cpp_lib_uncaught_exceptions
+        return std::uncaught_exceptions();
+#else
+        return std::uncaught_exception() ? 1 : 0;
+#endif
+      }
+
+    }
+
+
+
+    const std::string& Pipe::tmpfile_dir (int64_t size)
+    {
+#ifdef __linux__
+      //CONF option: PipeSharedMemory
+      //CONF default: 1 (true)
+      //CONF Whether to hold images passed between commands via Unix pipes
+      //CONF in POSIX shared memory (/dev/shm), rather than in a temporary
+      //CONF file within :option:`TmpFileDir`. This allows the image to be
+      //CONF passed to the next command without being written to the
+      //CONF filesystem. An image is only placed in shared memory if there is
+      //CONF sufficient space available to hold it; otherwise the temporary
+      //CONF file is used as before. Only applicable on Linux.
+      static const bool use_shared_memory = File::Config::get_bool ("PipeSharedMemory", true)
+        && Path::is_dir (shared_memory_dir) && !access (shared_memory_dir.c_str(), W_OK);
+      if (use_shared_memory) {
+        struct statvfs stats;
+        if (!statvfs (shared_memory_dir.c_str(), &stats) &&
+            int64_t (stats.f_bavail) * int64_t (stats.f_frsize) >= size + shared_memory_reserve)
+          return shared_memory_dir;
+        DEBUG ("insufficient shared memory for piped image - using temporary file instead");
+      }
+#endif
+      return File::tmpfile_dir();
+    }
+
+
+
 
     void Pipe::load (const Header& header, size_t)
     {
@@ -37,9 +113,68 @@ namespace MR
       if (double (bytes_per_segment) >= double (std::numeric_limits<size_t>::max()))
         throw Exception ("image \"" + header.name() + "\" is larger than maximum accessible memory");
 
+      const int64_t trailer_offset = (files[0].start + bytes_per_segment + 7) & ~int64_t(7);
+      num_volumes = header.ndim() == 4 ? header.size (3) : 1;
+      exceptions_on_load = exceptions_in_flight();
+
+#ifdef __linux__
+      if (is_new && in_shared_memory (files[0].name)) {
+        //CONF option: PipeStreaming
+        //CONF default: 0 (false)
+        //CONF Whether to stream 4D images passed between commands via Unix
+        //CONF pipes volume by volume, so that the next command can start
+        //CONF processing each volume as soon as it has been written, rather
+        //CONF than waiting for the whole image. This is only used for images
+        //CONF held in shared memory (see :option:`PipeSharedMemory`), and only
+        //CONF benefits commands that support it (currently mrconvert, mrcalc,
+        //CONF dwiextract and mrcat); other commands wait for the complete
+        //CONF image as usual.
+        static const bool streaming_enabled = File::Config::get_bool ("PipeStreaming", false);
+        const bool stream = streaming_enabled && header.ndim() == 4;
+        const int64_t file_size = stream ? trailer_offset + trailer_size : files[0].start + bytes_per_segment;
+        if (stream)
+          File::resize (files[0].name, file_size);
+
+        // allocate all pages up front: running out of shared memory while
+        // writing to the memory-mapped image would otherwise raise SIGBUS
+        const int fd = ::open (files[0].name.c_str(), O_RDWR);
+        const int status = fd < 0 ? errno : posix_fallocate (fd, 0, file_size);
+        if (fd >= 0)
+          ::close (fd);
+        if (status)
+          throw Exception ("error allocating shared memory for piped image \"" + files[0].name + "\": " + strerror (status)
+              + " (set PipeSharedMemory to false in your config file to use a temporary file instead)");
+
+        if (stream) {
+          trailer.reset (new File::MMap (File::Entry (files[0].name, trailer_offset), true, false, trailer_size));
+          memcpy (trailer->address(), trailer_magic, 8);
+          Raw::store_native<int64_t> (getpid(), trailer->address(), 1);
+          volumes_written().store (0, std::memory_order_release);
+        }
+      }
+#endif
+
+      struct stat sbuf;
+      if (!is_new && !stat (files[0].name.c_str(), &sbuf) && sbuf.st_size == trailer_offset + trailer_size) {
+        std::unique_ptr<File::MMap> candidate (new File::MMap (File::Entry (files[0].name, trailer_offset), false, true, trailer_size));
+        if (!memcmp (candidate->address(), trailer_magic, 8)) {
+          DEBUG ("piped image \"" + files[0].name + "\" is being streamed");
+          trailer = std::move (candidate);
+          if (!streaming)
+            wait_for_volumes (num_volumes);
+        }
+      }
+
       mmap.reset (new File::MMap (files[0], writable, !is_new, bytes_per_segment));
       addresses.resize (1);
       addresses[0].reset (mmap->address());
+      advise (header, *mmap);
+
+      if (is_new && trailer) {
+        // pass the image on straight away:
+        std::cout << files[0].name << "\n";
+        std::cout.flush();
+      }
     }
 
 
@@ -47,11 +182,21 @@ namespace MR
     {
       if (mmap) {
         mmap.reset();
-        if (is_new)
+        // streamed images are passed on as soon as they are created:
+        if (is_new && !trailer)
           std::cout << files[0].name << "\n";
         addresses[0].release();
       }
 
+      if (trailer) {
+        if (is_new) {
+          // flag the image as incomplete if we are unwinding due to an error:
+          const bool failed = exceptions_in_flight() > exceptions_on_load;
+          volumes_written().store (failed ? -1 : int64_t (num_volumes), std::memory_order_release);
+        }
+        trailer.reset();
+      }
+
       if (!is_new && files.size() == 1) {
         DEBUG ("deleting piped image file \"" + files[0].name + "\"...");
         unlink (files[0].name.c_str());
@@ -60,7 +205,39 @@ namespace MR
 
     }
 
-  }
-}
 
 
+    void Pipe::wait_for_volumes (size_t num)
+    {
+      if (!trailer || is_new)
+        return;
+      num = std::min (num, num_volumes);
+      const pid_t writer = Raw::fetch_native<int64_t> (trailer->address(), 1);
+      int delay = 1;
+      while (true) {
+        const int64_t written = volumes_written().load (std::memory_order_acquire);
+        if (written >= int64_t (num))
+          return;
+        if (written < 0)
+          throw Exception ("piped image \"" + files[0].name + "\" is incomplete due to an error in the previous command");
+        if (kill (writer, 0) && errno == ESRCH) {
+          if (volumes_written().load (std::memory_order_acquire) >= int64_t (num))
+            return;
+          throw Exception ("piped image \"" + files[0].name + "\" is incomplete: previous command terminated unexpectedly");
+        }
+        std::this_thread::sleep_for (std::chrono::milliseconds (delay));
+        delay = std::min (2*delay, 20);
+      }
+    }
+
+
+
+    void Pipe::publish_volumes (size_t num)
+    {
+      if (trailer && is_new)
+        volumes_written().store (std::min (num, num_volumes), std::memory_order_release);
+    }
+
+
+  }
+}
@@ -16,6 +16,8 @@
 #ifndef __image_io_pipe_h__
 #define __image_io_pipe_h__
 
+#include <atomic>
+
 #include "memory.h"
 #include "image_io/base.h"
 #include "file/mmap.h"
@@ -25,13 +27,49 @@ namespace MR
   namespace ImageIO
   {
 
+    //! handler for images passed between commands via a Unix pipe
+    /*! The image is written to a temporary file (in shared memory where
+     * possible), the name of which is passed to the next command through
+     * the pipe. That command then maps the same file, and deletes it once
+     * done.
+     *
+     * If the PipeStreaming config file option is set, 4D images created in
+     * shared memory are also streamed volume by volume: the file name is
+     * passed on as soon as the image is created, and a trailer following
+     * the image data records the number of volumes written so far, as
+     * signalled by the writer using publish_volumes(). A reader that has
+     * enabled streaming (see Header::set_streaming()) can then process each
+     * volume as soon as it is available, using wait_for_volumes(); any
+     * other reader waits until the whole image is complete. */
     class Pipe : public Base
     { NOMEMALIGN
       public:
-        Pipe (Base&& io_handler) : Base (std::move (io_handler)) { }
+        Pipe (Base&& io_handler) : Base (std::move (io_handler)), num_volumes (0), exceptions_on_load (0) { }
+
+        //! the folder in which to create a piped image of \a size bytes
+        /*! This is the shared memory folder if available, enabled, and
+         * large enough to hold the image, and the folder specified by the
+         * TmpFileDir config file option otherwise. */
+        static const std::string& tmpfile_dir (int64_t size);
+
+        virtual bool is_streamed () const { return bool (trailer); }
+        virtual void wait_for_volumes (size_t num);
+        virtual void publish_volumes (size_t num);
 
       protected:
         std::unique_ptr<File::MMap> mmap;
+        //! for streamed images: the trailer holding the number of volumes written
+        std::unique_ptr<File::MMap> trailer;
+        size_t num_volumes;
+        //! the number of exceptions propagating when the image was loaded
+        /*! unload() marks a streamed image as incomplete if there are
+         * more than this, i.e. if it is invoked due to an error. */
+        int exceptions_on_load;
+
+        static constexpr int64_t trailer_size = 24;
+        std::atomic<int64_t>& volumes_written () const {
+          return *reinterpret_cast<std::atomic<int64_t>*> (trailer->address() + 16);
+        }
 
         virtual void load (const Header&, size_t);
         virtual void unload (const Header&);
@@ -13,28 +13,217 @@
  */
 
 
+#include <atomic>
 #include <memory>
 
+#ifdef __linux__
+# include <sys/mman.h>
+# include <unistd.h>
+#endif
+
 #include "image_io/scratch.h"
 #include "header.h"
+#include "stride.h"
+#include "signal_handler.h"
+#include "thread.h"
+#include "file/config.h"
+#include "file/utils.h"
+
+// buffers smaller than this are zeroed using a single thread:
+#define SCRATCH_PARALLEL_INIT_MIN_SIZE (16*1024*1024)
 
 namespace MR
 {
   namespace ImageIO
   {
 
+    namespace
+    {
+
+      // number of bytes per position along the outermost axis (i.e. that
+      // with the largest stride), negative if the data are stored in
+      // reverse order along that axis:
+      ssize_t outer_slice_size (const Header& header)
+      {
+        const auto strides = Stride::get_actual (header);
+        const size_t axis = Stride::order (strides).back();
+        const ssize_t slice = (header.datatype().bits() * std::abs (strides[axis]) + 7) / 8;
+        return strides[axis] < 0 ? -slice : slice;
+      }
+
+
+      // on systems with a first-touch NUMA policy, the thread that zeroes
+      // each page determines which node it is allocated on. The buffer is
+      // therefore split in the same way as ThreadedLoop initially splits
+      // the outer axis between its threads: thread n zeroes the range
+      // covering outer positions [n*num/N, (n+1)*num/N), rounded to page
+      // boundaries, so that each page is allocated close to the thread that
+      // will start processing it.
+      void zero_init (uint8_t* data, size_t size, ssize_t outer_slice)
+      {
+        const size_t slice = std::abs (outer_slice);
+        // a thread pinned to a NUMA node initialises the buffer itself, so
+        // that its memory is allocated on that node:
+        const size_t num_threads = Thread::number_of_threads();
+        if (size < SCRATCH_PARALLEL_INIT_MIN_SIZE || num_threads < 2 || Thread::numa_node() >= 0 || !slice || slice >= size) {
+          memset (data, 0, size);
+          return;
+        }
+
+        size_t page_size = 4096;
+#ifdef __linux__
+        page_size = sysconf (_SC_PAGESIZE);
+#endif
+
+        struct Shared { NOMEMALIGN
+          uint8_t* data;
+          const size_t size, slice, num, num_threads, page_size;
+          const bool reversed;
+          std::atomic<size_t> next_thread;
+
+          // byte offset of the start of thread n's range, rounded to the
+          // nearest page boundary:
+          size_t boundary (size_t n) const {
+            if (!n)
+              return reversed ? size : 0;
+            if (n >= num_threads)
+              return reversed ? 0 : size;
+            size_t offset = ((n * num) / num_threads) * slice;
+            if (reversed)
+              offset = size - offset;
+            const uintptr_t start = reinterpret_cast<uintptr_t> (data);
+            const uintptr_t address = (start + offset + page_size/2) & ~uintptr_t (page_size - 1);
+            return std::min (size, size_t (std::max (address, start) - start));
+          }
+        } shared = { data, size, slice, size / slice, num_threads, page_size, outer_slice < 0, { 0 } };
+
+        struct PerThread { NOMEMALIGN
+          Shared& shared;
+          void execute () {
+            const size_t n = shared.next_thread++;
+            size_t first = shared.boundary (n), last = shared.boundary (n+1);
+            if (shared.reversed)
+              std::swap (first, last);
+            if (last > first)
+              memset (shared.data + first, 0, last - first);
+          }
+        } loop_thread = { shared };
+
+        Thread::run (Thread::multi (loop_thread, num_threads), "scratch buffer initialisation threads").wait();
+      }
+
+
+      void advise_huge_pages (uint8_t* data, size_t size)
+      {
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+        //CONF option: ScratchHugePages
+        //CONF default: 0 (false)
+        //CONF Whether to request transparent huge pages for large scratch
+        //CONF (in-memory) images, using madvise(). This can reduce the TLB
+        //CONF overhead of processing very large images, at the expense of
+        //CONF potentially higher memory usage. Only applies on Linux, and
+        //CONF to buffers larger than 32MB.
+        static const bool use_huge_pages = File::Config::get_bool ("ScratchHugePages", false);
+        if (!use_huge_pages || size < 32*1024*1024)
+          return;
+        const size_t page_size = sysconf (_SC_PAGESIZE);
+        const uintptr_t first = (reinterpret_cast<uintptr_t> (data) + page_size - 1) & ~uintptr_t (page_size - 1);
+        const uintptr_t last = (reinterpret_cast<uintptr_t> (data) + size) & ~uintptr_t (page_size - 1);
+        if (last > first && madvise (reinterpret_cast<void*> (first), last - first, MADV_HUGEPAGE))
+          DEBUG ("unable to request huge pages for scratch buffer: " + std::string (strerror (errno)));
+#else
+        (void) data;
+        (void) size;
+#endif
+      }
+
+
+
+      // total size of scratch buffers currently held in RAM:
+      std::atomic<size_t> ram_in_use (0);
+
+      //CONF option: ScratchMemoryBudget
+      //CONF default: 0 (no limit)
+      //CONF The maximum total amount of RAM (in MB) to use for scratch
+      //CONF (in-memory) images. Scratch images that would exceed this budget
+      //CONF are instead backed by a sparse temporary file, created within
+      //CONF :option:`TmpFileDir` and memory-mapped; the operating system can
+      //CONF then page their contents out to disk as needed, at the expense
+      //CONF of performance. This allows large jobs to complete on machines
+      //CONF with insufficient RAM. Note that TmpFileDir should then be set to
+      //CONF a location on a local disk, rather than a RAM-based filesystem
+      //CONF (as /tmp is on many systems); if it resides on a networked
+      //CONF filesystem, such images are held in RAM regardless.
+      size_t memory_budget ()
+      {
+        static const size_t budget = std::max (0.0f, File::Config::get_float ("ScratchMemoryBudget", 0.0f)) * 1024.0 * 1024.0;
+        return budget;
+      }
+
+      // reserve size bytes from the memory budget, returning false if this
+      // would exceed it:
+      bool reserve_ram (size_t size)
+      {
+        const size_t budget = memory_budget();
+        size_t current = ram_in_use.load();
+        do {
+          if (budget && current + size > budget)
+            return false;
+        } while (!ram_in_use.compare_exchange_weak (current, current + size));
+        return true;
+      }
+
+    }
+
+
+
     bool Scratch::is_file_backed () const { return false; }
 
     void Scratch::load (const Header& header, size_t buffer_size)
     {
       assert (buffer_size);
+      if (!reserve_ram (buffer_size)) {
+        // on a networked filesystem, File::MMap would hold the contents of
+        // the file in RAM regardless, and write them back on completion:
+        if (!File::is_networked (File::tmpfile_dir())) {
+          spill_to_disk (header, buffer_size);
+          return;
+        }
+        WARN ("scratch image \"" + header.name() + "\" exceeds memory budget, but temporary directory \""
+            + File::tmpfile_dir() + "\" resides on a networked filesystem - holding image in RAM instead");
+        ram_in_use += buffer_size;
+      }
+      ram_size = buffer_size;
       DEBUG ("allocating scratch buffer for image \"" + header.name() + "\"...");
       try {
         addresses.push_back (std::unique_ptr<uint8_t[]> (new uint8_t [buffer_size]));
-        memset (addresses[0].get(), 0, buffer_size);
       } catch (...) {
+        ram_in_use -= ram_size;
+        ram_size = 0;
         throw Exception ("Error allocating memory for scratch buffer");
       }
+      memory = MemoryUsage::Allocation (buffer_size);
+      advise_huge_pages (addresses[0].get(), buffer_size);
+      zero_init (addresses[0].get(), buffer_size, outer_slice_size (header));
+    }
+
+
+
+    void Scratch::spill_to_disk (const Header& header, size_t buffer_size)
+    {
+      INFO ("scratch image \"" + header.name() + "\" exceeds memory budget - using temporary file in \"" + File::tmpfile_dir() + "\"");
+      // the file is created sparse, and so will read as zero throughout:
+      const std::string filename = File::create_tempfile (buffer_size, "scratch");
+      SignalHandler::mark_file_for_deletion (filename);
+      try {
+        mmap.reset (new File::MMap (File::Entry (filename), true, false, buffer_size));
+      }
+      catch (...) {
+        SignalHandler::unmark_file_for_deletion (filename);
+        File::unlink (filename);
+        throw;
+      }
+      addresses.push_back (std::unique_ptr<uint8_t[]> (mmap->address()));
     }
 
 
@@ -42,7 +231,18 @@ namespace MR
     {
       if (addresses.size()) {
         DEBUG ("deleting scratch buffer for image \"" + header.name() + "\"...");
-        addresses[0].reset();
+        if (mmap) {
+          addresses[0].release();
+          const std::string filename = mmap->name();
+          mmap.reset();
+          SignalHandler::unmark_file_for_deletion (filename);
+          File::unlink (filename);
+        }
+        else {
+          addresses[0].reset();
+          ram_in_use -= ram_size;
+          ram_size = 0;
+        }
       }
     }
 
@@ -17,6 +17,7 @@
 #define __image_io_scratch_h__
 
 #include "image_io/base.h"
+#include "file/mmap.h"
 
 namespace MR
 {
@@ -24,16 +25,32 @@ namespace MR
   {
 
 
+    //! backend for scratch images, held in RAM
+    /*! If the ScratchMemoryBudget config file option is set, and allocating
+     * the buffer would take the total size of all scratch images held in
+     * RAM beyond that budget, the buffer is instead backed by a sparse
+     * temporary file in TmpFileDir, memory-mapped into RAM. The image can
+     * then be used as normal, but its contents may be paged out to disk by
+     * the operating system as required, rather than exhausting the
+     * available memory. */
     class Scratch : public Base
     { NOMEMALIGN
       public:
-        Scratch (const Header& header) : Base (header) { }
+        Scratch (const Header& header) : Base (header), ram_size (0) { }
 
         virtual bool is_file_backed () const;
 
+        //! whether the buffer is backed by a temporary file
+        bool is_spilled () const { return bool (mmap); }
+
       protected:
+        std::unique_ptr<File::MMap> mmap;
+        size_t ram_size;
+
         virtual void load (const Header&, size_t);
         virtual void unload (const Header&);
+
+        void spill_to_disk (const Header&, size_t);
     };
 
   }
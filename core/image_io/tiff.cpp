@@ -30,6 +30,7 @@ namespace MR
       DEBUG ("allocating buffer for TIFF image \"" + header.name() + "\"...");
       addresses.resize (1);
       addresses[0].reset (new uint8_t [footprint (header)]);
+      memory = MemoryUsage::Allocation (footprint (header));
       uint8_t* data = addresses[0].get();
 
       for (auto& entry : files) {
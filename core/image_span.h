@@ -0,0 +1,194 @@
+/*
+ * Copyright (c) 2008-2018 the MRtrix3 contributors.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at http://mozilla.org/MPL/2.0/
+ *
+ * MRtrix3 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * For more details, see http://www.mrtrix.org/
+ */
+
+
+#ifndef __image_span_h__
+#define __image_span_h__
+
+#include "image.h"
+
+namespace MR
+{
+
+
+  //! access a complete line of voxels along an axis as a contiguous array
+  /*! This class provides access to all values along \a axis through the
+   * current position of the image, as a plain array of \a ValueType. This
+   * allows per-line kernels to operate using Eigen maps or plain loops,
+   * rather than indexing the image voxel by voxel.
+   *
+   * Where the image is accessed using direct IO and the values along \a
+   * axis are contiguous in memory (i.e. its stride is 1), the array refers
+   * directly to the image data, and no copy is made. Otherwise, the values
+   * are copied into an internal buffer by load(), and written back to the
+   * image by store(); for indirect IO, the whole line is converted in one
+   * pass using Image::Buffer::get_values() and set_values().
+   *
+   * For example:
+   * \code
+   * auto in = Image<float>::open (argument[0]);
+   * ImageSpan<float> span (in, 3);
+   * for (auto l = Loop (in, 0, 3) (span.parent()); l; ++l) {
+   *   span.load();
+   *   span.array() *= 2.0;
+   *   span.store();
+   * }
+   * \endcode
+   *
+   * Each ImageSpan holds its own copy of the image and its own buffer, so
+   * that copies of an ImageSpan can be used concurrently in different
+   * threads. This is how ThreadedLoop's run_span() method operates.
+   *
+   * \sa ThreadedLoopRunOuter::run_span() */
+  //! an image whose lines are only written, for use with ImageSpan
+  /*! \sa write_only() */
+  template <typename ValueType>
+    struct WriteOnlyImage { NOMEMALIGN
+      using value_type = ValueType;
+      Image<ValueType>& image;
+    };
+
+  //! request write-only access to \a image through ThreadedLoop's run_span()
+  /*! The values along each line are then not fetched from the image by
+   * ImageSpan::load(), and must all be set by the functor. */
+  template <typename ValueType>
+    inline WriteOnlyImage<ValueType> write_only (Image<ValueType>& image) { return { image }; }
+
+
+
+  template <typename ValueType>
+    class ImageSpan { MEMALIGN (ImageSpan<ValueType>)
+      public:
+        using value_type = ValueType;
+        using array_type = Eigen::Array<ValueType, Eigen::Dynamic, 1>;
+        using vector_type = Eigen::Matrix<ValueType, Eigen::Dynamic, 1>;
+
+        //! access the values of \a image along \a axis
+        ImageSpan (Image<ValueType>& image, size_t axis) :
+          ImageSpan (image, axis, is_writable (image), true) { }
+
+        //! access the values of \a image along \a axis, for reading only
+        /*! store() will have no effect on this span. */
+        ImageSpan (const Image<ValueType>& image, size_t axis) :
+          ImageSpan (image, axis, false, true) { }
+
+        //! access the values of \a image along \a axis, for writing only
+        /*! load() will not fetch the current values from the image. */
+        ImageSpan (const WriteOnlyImage<ValueType>& image, size_t axis) :
+          ImageSpan (image.image, axis, is_writable (image.image), false) { }
+
+        ImageSpan (const ImageSpan& other) :
+          parent_ (other.parent_),
+          axis (other.axis),
+          length (other.length),
+          contiguous (other.contiguous),
+          writable (other.writable),
+          preload (other.preload),
+          data_ (nullptr) { }
+
+        //! the image through which the data are accessed
+        /*! Set the position of this image along the axes other than \a axis
+         * before invoking load(). */
+        FORCE_INLINE Image<ValueType>& parent () { return parent_; }
+        FORCE_INLINE const Image<ValueType>& parent () const { return parent_; }
+
+        //! the number of values along the line
+        FORCE_INLINE ssize_t size () const { return length; }
+        //! whether the values are accessed in place, without copying
+        FORCE_INLINE bool is_zero_copy () const { return contiguous; }
+
+        //! fetch the values along the line through the current image position
+        /*! For write-only spans, this only sets up access to the line. */
+        void load () {
+          parent_.index (axis) = 0;
+          if (contiguous) {
+            data_ = parent_.address();
+            return;
+          }
+          if (!buffer)
+            buffer.reset (new ValueType [length]);
+          data_ = buffer.get();
+          if (!preload)
+            return;
+          if (is_ram (parent_)) {
+            const ValueType* p = parent_.address();
+            const ssize_t stride = parent_.stride (axis);
+            for (ssize_t n = 0; n < length; ++n)
+              data_[n] = p[n*stride];
+          }
+          else
+            parent_.buffer->get_values (data_, parent_.offset(), parent_.stride (axis), length);
+        }
+
+        //! write any modified values back to the image
+        /*! This has no effect if the data are accessed in place, or if the
+         * image is not writable. */
+        void store () {
+          if (contiguous || !writable)
+            return;
+          if (is_ram (parent_)) {
+            ValueType* p = parent_.address();
+            const ssize_t stride = parent_.stride (axis);
+            for (ssize_t n = 0; n < length; ++n)
+              p[n*stride] = data_[n];
+          }
+          else
+            parent_.buffer->set_values (data_, parent_.offset(), parent_.stride (axis), length);
+        }
+
+        FORCE_INLINE ValueType* data () { return data_; }
+        FORCE_INLINE const ValueType* data () const { return data_; }
+        FORCE_INLINE ValueType& operator[] (ssize_t n) { assert (n >= 0 && n < length); return data_[n]; }
+        FORCE_INLINE const ValueType& operator[] (ssize_t n) const { assert (n >= 0 && n < length); return data_[n]; }
+
+        //! the values as an Eigen array
+        FORCE_INLINE Eigen::Map<array_type> array () { return { data_, length }; }
+        FORCE_INLINE Eigen::Map<const array_type> array () const { return { data_, length }; }
+        //! the values as an Eigen column vector
+        FORCE_INLINE Eigen::Map<vector_type> matrix () { return { data_, length }; }
+        FORCE_INLINE Eigen::Map<const vector_type> matrix () const { return { data_, length }; }
+
+      protected:
+        Image<ValueType> parent_;
+        const size_t axis;
+        const ssize_t length;
+        const bool contiguous, writable, preload;
+        ValueType* data_;
+        std::unique_ptr<ValueType[]> buffer;
+
+        // whether values can be addressed in RAM (bitwise data cannot):
+        static bool is_ram (const Image<ValueType>& image) {
+          return image.is_direct_io() && !std::is_same<ValueType,bool>::value;
+        }
+
+        ImageSpan (const Image<ValueType>& image, size_t axis, bool writable, bool preload) :
+          parent_ (image),
+          axis (axis),
+          length (image.size (axis)),
+          contiguous (is_ram (image) && image.stride (axis) == 1),
+          writable (writable),
+          preload (preload),
+          data_ (nullptr) { }
+
+        static bool is_writable (const Image<ValueType>& image) {
+          const ImageIO::Base* io = image.buffer->get_io();
+          return !io || !io->is_file_backed() || io->is_image_new() || io->is_image_readwrite();
+        }
+    };
+
+
+}
+
+#endif
+
@@ -0,0 +1,132 @@
+/*
+ * Copyright (c) 2008-2018 the MRtrix3 contributors.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at http://mozilla.org/MPL/2.0/
+ *
+ * MRtrix3 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * For more details, see http://www.mrtrix.org/
+ */
+
+
+#include <algorithm>
+#include <cassert>
+#include <mutex>
+#ifndef MRTRIX_WINDOWS
+# include <sys/resource.h>
+#endif
+
+#include "app.h"
+#include "memory_usage.h"
+
+namespace MR
+{
+  namespace MemoryUsage
+  {
+
+    namespace {
+
+      // allocations are few, and large, so a single lock is not an issue:
+      std::mutex mutex;
+      size_t in_use = 0, max_in_use = 0;
+      vector<Tracker*> trackers;
+
+      inline std::string MB (size_t bytes)
+      {
+        return str (bytes / (1024.0*1024.0), 4) + " MB";
+      }
+
+    }
+
+
+
+    size_t current ()
+    {
+      std::lock_guard<std::mutex> lock (mutex);
+      return in_use;
+    }
+
+    size_t peak ()
+    {
+      std::lock_guard<std::mutex> lock (mutex);
+      return max_in_use;
+    }
+
+
+
+#ifdef MRTRIX_WINDOWS
+    size_t peak_resident () { return 0; }
+#else
+    size_t peak_resident ()
+    {
+      struct rusage usage;
+      getrusage (RUSAGE_SELF, &usage);
+# ifdef MRTRIX_MACOSX
+      return usage.ru_maxrss;
+# else
+      return size_t (usage.ru_maxrss) * 1024;
+# endif
+    }
+#endif
+
+
+
+    void report ()
+    {
+      if (App::log_level < 2)
+        return;
+      std::string message = "peak memory usage: " + MB (peak()) + " in image data & matrices";
+      const size_t resident = peak_resident();
+      if (resident)
+        message += ", " + MB (resident) + " in total";
+      INFO (message);
+    }
+
+
+
+
+    void Allocation::add (size_t bytes)
+    {
+      std::lock_guard<std::mutex> lock (mutex);
+      in_use += bytes;
+      max_in_use = std::max (max_in_use, in_use);
+      for (auto t : trackers)
+        t->max = std::max (t->max, in_use);
+    }
+
+    void Allocation::remove (size_t bytes)
+    {
+      std::lock_guard<std::mutex> lock (mutex);
+      assert (bytes <= in_use);
+      in_use -= bytes;
+    }
+
+
+
+
+    Tracker::Tracker ()
+    {
+      std::lock_guard<std::mutex> lock (mutex);
+      max = in_use;
+      trackers.push_back (this);
+    }
+
+    Tracker::~Tracker ()
+    {
+      std::lock_guard<std::mutex> lock (mutex);
+      trackers.erase (std::find (trackers.begin(), trackers.end(), this));
+    }
+
+    size_t Tracker::peak () const
+    {
+      std::lock_guard<std::mutex> lock (mutex);
+      return max;
+    }
+
+  }
+}
+
@@ -0,0 +1,118 @@
+/*
+ * Copyright (c) 2008-2018 the MRtrix3 contributors.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at http://mozilla.org/MPL/2.0/
+ *
+ * MRtrix3 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * For more details, see http://www.mrtrix.org/
+ */
+
+
+#ifndef __memory_usage_h__
+#define __memory_usage_h__
+
+#include <cstddef>
+#include <cstdint>
+
+#define NOMEMALIGN
+
+namespace MR
+{
+
+  //! Accounting of the memory used by the largest allocations
+  /*! Most of the memory used by MRtrix3 commands is taken up by image data
+   * held in RAM (scratch images, compressed images, preloaded data, etc.)
+   * and by large matrices. These allocations are registered here, so that
+   * the amount of memory in use can be tracked over the course of the
+   * command, and its peak reported for each processing phase (at -info
+   * level, or in the execution profile; see the -profile option).
+   *
+   * Note that memory-mapped files are not included, since the system can
+   * page these in and out as required. */
+  namespace MemoryUsage
+  {
+
+    //! the number of bytes currently registered
+    size_t current ();
+    //! the largest number of bytes registered at any one time
+    size_t peak ();
+    //! the peak resident set size of the process (in bytes)
+    /*! This is as reported by the system, and includes all memory in use,
+     * whether registered or not. Returns zero if not available. */
+    size_t peak_resident ();
+
+    //! report the peak memory usage for the whole command, at -info level
+    void report ();
+
+
+    //! RAII object registering an allocation for the duration of its lifetime
+    /*! This should be held alongside the memory it refers to, so that the
+     * allocation is unregistered when that memory is freed. */
+    class Allocation { NOMEMALIGN
+      public:
+        Allocation () : bytes (0) { }
+        explicit Allocation (size_t bytes) : bytes (bytes) { add (bytes); }
+        Allocation (const Allocation&) = delete;
+        Allocation (Allocation&& other) noexcept : bytes (other.bytes) { other.bytes = 0; }
+        Allocation& operator= (const Allocation&) = delete;
+        Allocation& operator= (Allocation&& other) noexcept {
+          reset();
+          bytes = other.bytes;
+          other.bytes = 0;
+          return *this;
+        }
+        ~Allocation () { reset(); }
+
+        //! unregister the allocation
+        void reset () {
+          if (bytes)
+            remove (bytes);
+          bytes = 0;
+        }
+        size_t size () const { return bytes; }
+
+      private:
+        size_t bytes;
+
+        static void add (size_t bytes);
+        static void remove (size_t bytes);
+    };
+
+
+    //! register the memory held by a (dense) Eigen matrix or array
+    /*! For example:
+     * \code
+     * matrix_type data (num_elements, num_subjects);
+     * const auto data_usage = MemoryUsage::track (data);
+     * \endcode */
+    template <class MatrixType>
+      inline Allocation track (const MatrixType& M) {
+        return Allocation (M.size() * sizeof (typename MatrixType::Scalar));
+      }
+
+
+    //! RAII object recording the peak memory registered over its lifetime
+    class Tracker { NOMEMALIGN
+      public:
+        Tracker ();
+        Tracker (const Tracker&) = delete;
+        ~Tracker ();
+
+        //! the peak number of bytes registered since construction
+        size_t peak () const;
+
+      private:
+        size_t max;
+        friend class Allocation;
+    };
+
+  }
+}
+
+#endif
+
@@ -0,0 +1,231 @@
+/*
+ * Copyright (c) 2008-2018 the MRtrix3 contributors.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at http://mozilla.org/MPL/2.0/
+ *
+ * MRtrix3 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * For more details, see http://www.mrtrix.org/
+ */
+
+
+#include <atomic>
+#include <chrono>
+#include <ctime>
+#include <cstring>
+#include <mutex>
+#ifndef MRTRIX_WINDOWS
+# include <sys/resource.h>
+#endif
+
+#include "app.h"
+#include "profiler.h"
+#include "thread.h"
+#include "file/json.h"
+#include "file/ofstream.h"
+
+namespace MR
+{
+  namespace Profiler
+  {
+
+    bool __active = false;
+
+    namespace {
+
+      class Event { NOMEMALIGN
+        public:
+          std::string name;
+          const char* category;
+          int thread;
+          int64_t start, duration, cpu_time; // all in microseconds
+          size_t peak_rss_so_far, peak_memory; // in bytes
+      };
+
+      std::string output_path;
+      std::chrono::steady_clock::time_point origin;
+      std::mutex mutex;
+      vector<Event> events;
+      std::atomic<int> next_thread_index (0);
+      thread_local int thread_index = -1;
+
+
+
+      int current_thread ()
+      {
+        if (thread_index < 0)
+          thread_index = next_thread_index++;
+        return thread_index;
+      }
+
+      int64_t wall_time ()
+      {
+        return std::chrono::duration_cast<std::chrono::microseconds> (std::chrono::steady_clock::now() - origin).count();
+      }
+
+#ifdef MRTRIX_WINDOWS
+      int64_t cpu_time (bool) { return int64_t (1.0e6 * std::clock() / CLOCKS_PER_SEC); }
+#else
+      int64_t cpu_time (bool this_thread_only)
+      {
+        if (this_thread_only) {
+          struct timespec t;
+          if (clock_gettime (CLOCK_THREAD_CPUTIME_ID, &t) == 0)
+            return int64_t (t.tv_sec) * 1000000 + t.tv_nsec / 1000;
+        }
+        struct rusage usage;
+        getrusage (RUSAGE_SELF, &usage);
+        return int64_t (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000
+          + usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+      }
+#endif
+
+      inline double MB (size_t bytes)
+      {
+        return bytes / (1024.0*1024.0);
+      }
+
+      inline bool thread_cpu_time (const char* category)
+      {
+        return strcmp (category, "thread") == 0;
+      }
+
+    }
+
+
+
+
+
+    void start (const std::string& path)
+    {
+      std::lock_guard<std::mutex> lock (mutex);
+      output_path = path;
+      origin = std::chrono::steady_clock::now();
+      current_thread();
+      __active = true;
+      INFO ("recording execution profile to file \"" + path + "\"");
+    }
+
+
+
+
+    void Scope::begin (const std::string& event_name)
+    {
+      name = event_name;
+      wall_start = wall_time();
+      cpu_start = cpu_time (thread_cpu_time (category));
+      memory.reset (new MemoryUsage::Tracker);
+    }
+
+
+
+    void Scope::end ()
+    {
+      Event event;
+      event.name = std::move (name);
+      event.category = category;
+      event.thread = current_thread();
+      event.start = wall_start;
+      event.duration = wall_time() - wall_start;
+      event.cpu_time = cpu_time (thread_cpu_time (category)) - cpu_start;
+      event.peak_rss_so_far = MemoryUsage::peak_resident();
+      event.peak_memory = memory->peak();
+      memory.reset();
+
+      std::lock_guard<std::mutex> lock (mutex);
+      if (__active)
+        events.push_back (std::move (event));
+    }
+
+
+
+
+    void write ()
+    {
+      if (!__active)
+        return;
+
+      std::lock_guard<std::mutex> lock (mutex);
+      __active = false;
+
+      const int64_t total = wall_time();
+      nlohmann::json trace;
+      auto& list = trace["traceEvents"];
+
+      nlohmann::json process;
+      process["ph"] = "M";
+      process["name"] = "process_name";
+      process["pid"] = 0;
+      process["tid"] = 0;
+      process["args"]["name"] = App::NAME;
+      list.push_back (process);
+
+      for (int n = 0; n < next_thread_index; ++n) {
+        nlohmann::json thread;
+        thread["ph"] = "M";
+        thread["name"] = "thread_name";
+        thread["pid"] = 0;
+        thread["tid"] = n;
+        thread["args"]["name"] = n ? "worker " + str(n) : std::string ("main");
+        list.push_back (thread);
+      }
+
+      nlohmann::json command;
+      command["ph"] = "X";
+      command["cat"] = "command";
+      command["name"] = App::NAME;
+      command["pid"] = 0;
+      command["tid"] = 0;
+      command["ts"] = 0;
+      command["dur"] = total;
+      command["args"]["cpu_time_ms"] = 1.0e-3 * cpu_time (false);
+      command["args"]["peak_rss_MB"] = MB (MemoryUsage::peak_resident());
+      command["args"]["peak_image_data_MB"] = MB (MemoryUsage::peak());
+      list.push_back (command);
+
+      for (const auto& e : events) {
+        nlohmann::json event;
+        event["ph"] = "X";
+        event["cat"] = e.category;
+        event["name"] = e.name;
+        event["pid"] = 0;
+        event["tid"] = e.thread;
+        event["ts"] = e.start;
+        event["dur"] = e.duration;
+        event["args"]["cpu_time_ms"] = 1.0e-3 * e.cpu_time;
+        event["args"]["peak_rss_so_far_MB"] = MB (e.peak_rss_so_far);
+        event["args"]["peak_image_data_MB"] = MB (e.peak_memory);
+        list.push_back (event);
+
+        nlohmann::json counter;
+        counter["ph"] = "C";
+        counter["name"] = "peak memory (MB)";
+        counter["pid"] = 0;
+        counter["ts"] = e.start + e.duration;
+        counter["args"]["resident (peak so far)"] = MB (e.peak_rss_so_far);
+        counter["args"]["image data"] = MB (e.peak_memory);
+        list.push_back (counter);
+      }
+
+      trace["displayTimeUnit"] = "ms";
+      trace["otherData"]["command"] = App::NAME;
+      trace["otherData"]["version"] = App::mrtrix_version;
+      trace["otherData"]["nthreads"] = Thread::number_of_threads();
+
+      try {
+        File::OFStream out (output_path);
+        out << trace.dump() << "\n";
+        INFO ("execution profile written to \"" + output_path + "\"");
+      }
+      catch (Exception& E) {
+        E.display();
+      }
+    }
+
+  }
+}
+
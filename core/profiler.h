@@ -0,0 +1,96 @@
+/*
+ * Copyright (c) 2008-2018 the MRtrix3 contributors.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at http://mozilla.org/MPL/2.0/
+ *
+ * MRtrix3 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * For more details, see http://www.mrtrix.org/
+ */
+
+
+#ifndef __profiler_h__
+#define __profiler_h__
+
+#include <memory>
+#include <string>
+#include <cstdint>
+
+#include "memory_usage.h"
+
+#define NOMEMALIGN
+
+namespace MR
+{
+
+  //! Process-wide profiling of commands, as requested via the -profile option
+  /*! When active, the Profiler records the wall time, CPU time and peak
+   * registered memory (see MemoryUsage) of each ProgressBar phase and of
+   * each thread launched via Thread::run(), along with the peak resident
+   * memory of the process so far at the end of each, and writes these out
+   * as a Chrome trace-event JSON file once
+   * the command completes. This file can be loaded into any trace viewer that
+   * supports this format (e.g. chrome://tracing or https://ui.perfetto.dev).
+   *
+   * When the profiler is not active, a Profiler::Scope reduces to a single
+   * test of a global flag. */
+  namespace Profiler
+  {
+
+    extern bool __active;
+
+    //! whether a trace is currently being recorded
+    inline bool active () { return __active; }
+
+    //! start recording, to be written to \a path when write() is invoked
+    void start (const std::string& path);
+
+    //! write the trace recorded so far to the file specified in start()
+    /*! This is invoked automatically once the command's run() function
+     * completes (or fails). It does nothing if the profiler is not active. */
+    void write ();
+
+    //! RAII object recording a single event for the duration of its scope
+    /*! The \a category should be a string literal (it is not copied), and
+     * determines how the CPU time of the event is measured: for the
+     * "thread" category, the CPU time of the calling thread is used; for all
+     * others, the CPU time of the whole process (i.e. summed over all
+     * threads) is used. */
+    class Scope { NOMEMALIGN
+      public:
+        Scope (const std::string& name, const char* category = "phase") :
+          category (active() ? category : nullptr) {
+            if (this->category)
+              begin (name);
+          }
+        Scope (const Scope&) = delete;
+        ~Scope () {
+          if (category)
+            end();
+        }
+
+        //! change the name under which the event will be recorded
+        void set_name (const std::string& new_name) {
+          if (category)
+            name = new_name;
+        }
+
+      private:
+        const char* category;
+        std::string name;
+        int64_t wall_start, cpu_start;
+        std::unique_ptr<MemoryUsage::Tracker> memory;
+
+        void begin (const std::string& name);
+        void end ();
+    };
+
+  }
+}
+
+#endif
+
@@ -25,6 +25,7 @@
 #include "types.h"
 #include "math/math.h"
 #include "debug.h"
+#include "profiler.h"
 
 #define BUSY_INTERVAL 0.1
 
@@ -216,9 +217,17 @@ namespace MR
        * display a busy indicator, updated at regular time intervals.
        * Otherwise, the ProgressBar will display the percentage completed,
        * computed from the number of times the ProgressBar::operator++()
-       * function was called relative to the value specified with \a target. */
+       * function was called relative to the value specified with \a target.
+       *
+       * If the Profiler is active, the lifetime of the ProgressBar is also
+       * recorded as a processing phase in the execution profile, irrespective
+       * of whether the progress is actually shown. At -info level, the peak
+       * memory registered over the lifetime of the ProgressBar (see
+       * MemoryUsage) is also reported once it completes. */
       ProgressBar (const std::string& text, size_t target = 0, int log_level = 1) :
-        show (App::log_level >= log_level), text (text), target (target) { }
+        show (App::log_level >= log_level), text (text), target (target),
+        phase (Profiler::active() ? new Profiler::Scope (text) : nullptr),
+        memory (show && App::log_level > 1 ? new MemoryUsage::Tracker : nullptr) { }
 
       //! returns whether the progress will be shown
       /*! The progress may not be shown if the -quiet option has been supplied
@@ -296,8 +305,26 @@ namespace MR
         ++ (*this);
       }
 
+      ~ProgressBar () {
+        done();
+      }
+
+      //! stop displaying progress, and end the phase in the execution profile
+      /*! If progress has been shown, the phase is recorded under the final
+       * text displayed, since this may have been updated to be more
+       * informative than the initial text. */
       FORCE_INLINE void done () {
+        const std::string final_text = prog ? prog->text : text;
+        if (phase && prog)
+          phase->set_name (final_text);
         prog.reset();
+        phase.reset();
+        if (memory) {
+          const size_t peak = memory->peak();
+          memory.reset();
+          if (peak)
+            INFO ("peak memory usage for \"" + final_text + "\": " + str (peak / (1024.0*1024.0), 4) + " MB");
+        }
       }
 
 
@@ -307,6 +334,8 @@ namespace MR
       const bool show;
       std::string text;
       size_t target;
+      std::unique_ptr<Profiler::Scope> phase;
+      std::unique_ptr<MemoryUsage::Tracker> memory;
       std::unique_ptr<ProgressInfo> prog;
   };
 
@@ -15,10 +15,23 @@
 
 #include <thread>
 #include <atomic>
+#include <deque>
+#include <condition_variable>
+#include <fstream>
+#include <algorithm>
+#include <limits>
+#ifdef __linux__
+# include <sched.h>
+# include <pthread.h>
+#endif
 
 #include "app.h"
+#include "profiler.h"
 #include "thread.h"
 #include "file/config.h"
+#include "file/json.h"
+#include "file/ofstream.h"
+#include "file/path.h"
 #include "thread_queue.h"
 
 namespace MR
@@ -79,6 +92,406 @@ namespace MR
 
 
 
+    //CONF option: ThreadAffinity
+    //CONF default: `none`
+    //CONF Pin worker threads to specific CPU cores. With `none`,
+    //CONF placement is left to the operating system; `compact` fills
+    //CONF the cores of each NUMA node (typically a CPU socket) in turn;
+    //CONF `scatter` distributes threads evenly across NUMA nodes.
+    //CONF Alternatively, a list of CPU indices (e.g. `0,2,4:7`) can
+    //CONF be provided, to which threads are assigned in turn. This can be
+    //CONF overridden using the -affinity option where available.
+
+    namespace {
+
+      // the CPUs available to this process, grouped by NUMA node:
+      vector<vector<size_t>> cpu_topology ()
+      {
+        vector<vector<size_t>> nodes;
+#ifdef __linux__
+        cpu_set_t allowed;
+        CPU_ZERO (&allowed);
+        if (sched_getaffinity (0, sizeof (allowed), &allowed))
+          return nodes;
+
+        vector<size_t> node_indices;
+        try {
+          Path::Dir dir ("/sys/devices/system/node");
+          std::string entry;
+          while ((entry = dir.read_name()).size())
+            if (entry.size() > 4 && entry.substr (0, 4) == "node" && isdigit (entry[4]))
+              node_indices.push_back (to<size_t> (entry.substr (4)));
+        }
+        catch (...) { }
+        std::sort (node_indices.begin(), node_indices.end());
+
+        for (auto n : node_indices) {
+          std::ifstream in ("/sys/devices/system/node/node" + str(n) + "/cpulist");
+          std::string list;
+          if (!std::getline (in, list) || (list = strip (list)).empty())
+            continue;
+          replace (list, '-', ':');
+          vector<size_t> cpus;
+          for (auto cpu : parse_ints (list))
+            if (CPU_ISSET (cpu, &allowed))
+              cpus.push_back (cpu);
+          if (cpus.size())
+            nodes.push_back (std::move (cpus));
+        }
+
+        if (nodes.empty()) {
+          nodes.push_back (vector<size_t>());
+          for (size_t cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+            if (CPU_ISSET (cpu, &allowed))
+              nodes[0].push_back (cpu);
+        }
+#endif
+        return nodes;
+      }
+
+
+      // the CPU each worker thread is pinned to (in turn), along with its
+      // NUMA node - empty if threads are not to be pinned:
+      class Affinity { NOMEMALIGN
+        public:
+          Affinity () {
+            std::string spec = File::Config::get ("ThreadAffinity", "none");
+            auto opt = App::get_options ("affinity");
+            if (opt.size())
+              spec = std::string (opt[0][0]);
+            spec = lowercase (strip (spec));
+            if (spec.empty() || spec == "none")
+              return;
+
+#ifdef __linux__
+            const auto nodes = cpu_topology();
+            if (spec == "compact") {
+              for (size_t n = 0; n < nodes.size(); ++n)
+                for (auto cpu : nodes[n])
+                  add (cpu, n);
+            }
+            else if (spec == "scatter") {
+              for (size_t i = 0; ; ++i) {
+                bool added = false;
+                for (size_t n = 0; n < nodes.size(); ++n) {
+                  if (i < nodes[n].size()) {
+                    add (nodes[n][i], n);
+                    added = true;
+                  }
+                }
+                if (!added) break;
+              }
+            }
+            else {
+              vector<int> list;
+              try { list = parse_ints (spec); }
+              catch (Exception& E) {
+                throw Exception (E, "invalid thread affinity specification \"" + spec + "\"");
+              }
+              for (auto cpu : list) {
+                size_t node = nodes.size();
+                for (size_t n = 0; n < nodes.size(); ++n)
+                  if (std::find (nodes[n].begin(), nodes[n].end(), size_t (cpu)) != nodes[n].end())
+                    node = n;
+                if (node == nodes.size())
+                  throw Exception ("CPU " + str(cpu) + " in thread affinity specification is not available to this process");
+                add (cpu, node);
+              }
+            }
+            if (cpus.empty()) {
+              WARN ("unable to determine CPU topology - worker threads will not be pinned to specific CPUs");
+            }
+            else {
+              INFO ("pinning worker threads to CPUs " + join (cpus, ",") + " (" + spec + ")");
+            }
+#else
+            WARN ("thread affinity is not supported on this platform - ignored");
+#endif
+          }
+
+          bool enabled () const { return cpus.size(); }
+
+          // the CPU and NUMA node for the worker thread with index given:
+          size_t cpu (size_t index) const { return cpus[index % cpus.size()]; }
+          size_t node (size_t index) const { return nodes[index % cpus.size()]; }
+
+          // number of NUMA nodes spanned by the first nthreads workers:
+          size_t num_nodes (size_t nthreads) const {
+            vector<size_t> used (nodes.begin(), nodes.begin() + std::min (std::max (nthreads, size_t(1)), nodes.size()));
+            std::sort (used.begin(), used.end());
+            return std::max (size_t (std::unique (used.begin(), used.end()) - used.begin()), size_t (1));
+          }
+
+        private:
+          vector<size_t> cpus, nodes;
+
+          void add (size_t cpu, size_t node) {
+            cpus.push_back (cpu);
+            nodes.push_back (node);
+          }
+      };
+
+      const Affinity& affinity ()
+      {
+        static const Affinity instance;
+        return instance;
+      }
+
+      thread_local int __numa_node = -1;
+
+    }
+
+
+
+    const App::Option AffinityOption
+    = App::Option ("affinity",
+                   "pin worker threads to specific CPU cores; options are: none, compact "
+                   "(fill the cores of each NUMA node / CPU socket in turn), scatter "
+                   "(distribute threads evenly across NUMA nodes), or a comma-separated "
+                   "list of CPU indices. The default can be set using the ThreadAffinity "
+                   "entry in the configuration file.")
+    + App::Argument ("spec").type_text();
+
+
+
+    int numa_node ()
+    {
+      return __numa_node;
+    }
+
+    size_t num_numa_nodes ()
+    {
+      return affinity().enabled() ? affinity().num_nodes (number_of_threads()) : 1;
+    }
+
+
+
+
+
+    namespace {
+
+      class ThreadPool { NOMEMALIGN
+        public:
+          ThreadPool () : idle (0), total (0) { }
+
+          std::future<void> launch (std::function<void()>&& func) {
+            // parse affinity settings (and report any errors) in the calling thread:
+            affinity();
+            std::packaged_task<void()> task (std::move (func));
+            auto future = task.get_future();
+            std::lock_guard<std::mutex> lock (mutex);
+            tasks.push_back (std::move (task));
+            if (idle >= tasks.size()) {
+              more_tasks.notify_one();
+            }
+            else {
+              ++total;
+              DEBUG ("adding worker thread to thread pool (" + str (total) + " in total)");
+              std::thread (&ThreadPool::worker, this).detach();
+            }
+            return future;
+          }
+
+        private:
+          std::mutex mutex;
+          std::condition_variable more_tasks;
+          std::deque<std::packaged_task<void()>> tasks;
+          size_t idle, total;
+          // which CPUs in the affinity list are used by running tasks:
+          vector<bool> slots;
+
+          void worker () {
+            size_t pinned = std::numeric_limits<size_t>::max();
+            std::unique_lock<std::mutex> lock (mutex);
+            while (true) {
+              while (tasks.empty()) {
+                ++idle;
+                more_tasks.wait (lock);
+                --idle;
+              }
+              auto task = std::move (tasks.front());
+              tasks.pop_front();
+              // pin each task to the first CPU not used by any other running
+              // task, so that N concurrent tasks run on the first N CPUs in
+              // the list, whichever workers happen to pick them up:
+              const size_t slot = std::find (slots.begin(), slots.end(), false) - slots.begin();
+              if (slot == slots.size())
+                slots.push_back (true);
+              else
+                slots[slot] = true;
+              lock.unlock();
+              if (slot != pinned) {
+                pin (slot);
+                pinned = slot;
+              }
+              task();
+              lock.lock();
+              slots[slot] = false;
+            }
+          }
+
+          static void pin (size_t index) {
+            if (!affinity().enabled())
+              return;
+#ifdef __linux__
+            cpu_set_t set;
+            CPU_ZERO (&set);
+            CPU_SET (affinity().cpu (index), &set);
+            if (pthread_setaffinity_np (pthread_self(), sizeof (set), &set)) {
+              DEBUG ("unable to pin worker thread " + str(index) + " to CPU " + str(affinity().cpu (index)));
+              return;
+            }
+            __numa_node = affinity().node (index);
+#endif
+          }
+      };
+
+    }
+
+
+
+    std::future<void> __launch (std::function<void()>&& task, const std::string& name)
+    {
+      // the pool is never destroyed, since its (detached) worker threads
+      // remain blocked on it until the process exits:
+      static ThreadPool* pool = new ThreadPool;
+      if (Profiler::active()) {
+        std::function<void()> functor (std::move (task));
+        task = [functor,name] () { Profiler::Scope scope (name, "thread"); functor(); };
+      }
+      return pool->launch (std::move (task));
+    }
+
+
+
+
+
+
+    //CONF option: QueueAdaptiveBatching
+    //CONF default: 1 (true)
+    //CONF Whether multi-threaded queue pipelines that process items in
+    //CONF batches should adjust the size of each batch at runtime, based
+    //CONF on the measured time taken per item and the occupancy of the
+    //CONF queue. If false, a fixed batch size of 128 items is used instead,
+    //CONF unless the command sets a specific size.
+
+    bool __adaptive_batching ()
+    {
+      static const bool adaptive = File::Config::get_bool ("QueueAdaptiveBatching", true);
+      return adaptive;
+    }
+
+
+
+    //CONF option: QueueProfile
+    //CONF default: 0 (false)
+    //CONF Record the time spent by each stage of multi-threaded queue
+    //CONF pipelines processing items, waiting on empty input queues and
+    //CONF blocked on full output queues, along with the occupancy of each
+    //CONF queue; a summary is displayed at the end of each pipeline at
+    //CONF -info level. Can also be enabled by setting the
+    //CONF MRTRIX_QUEUE_PROFILE environment variable.
+
+    //CONF option: QueueProfileFile
+    //CONF default: (none)
+    //CONF Append the results of queue pipeline profiling (see QueueProfile)
+    //CONF to this file, as one line of JSON per pipeline; implies
+    //CONF QueueProfile. Can also be set using the MRTRIX_QUEUE_PROFILE_FILE
+    //CONF environment variable.
+
+    namespace {
+
+      std::string queue_profile_file ()
+      {
+        const char* from_env = getenv ("MRTRIX_QUEUE_PROFILE_FILE");
+        if (from_env && *from_env)
+          return from_env;
+        return File::Config::get ("QueueProfileFile");
+      }
+
+      inline double seconds (uint64_t nanoseconds) { return 1.0e-9 * nanoseconds; }
+
+      inline std::string percent (uint64_t part, uint64_t total)
+      {
+        return str (total ? 100.0 * part / total : 0.0, 3) + "%";
+      }
+
+    }
+
+
+
+    bool __QueueProfile::enabled ()
+    {
+      static const bool is_enabled = [] () {
+        const char* from_env = getenv ("MRTRIX_QUEUE_PROFILE");
+        if (from_env && *from_env)
+          return std::string (from_env) != "0";
+        return File::Config::get_bool ("QueueProfile", false) || queue_profile_file().size();
+      } ();
+      return is_enabled;
+    }
+
+
+
+    void __QueueProfile::report () const
+    {
+      if (!active)
+        return;
+      const uint64_t wall_time = std::chrono::duration_cast<std::chrono::nanoseconds> (clock::now() - start).count();
+
+      INFO ("queue pipeline completed in " + str (seconds (wall_time), 4) + " s:");
+      for (const auto& s : stages) {
+        const uint64_t elapsed = s.elapsed, busy = s.busy, input_wait = s.input_wait, output_wait = s.output_wait;
+        INFO ("  stage \"" + s.name + "\" (" + str (size_t (s.threads)) + " thread" + (s.threads > 1 ? "s" : "") + "): "
+            + str (size_t (s.items_in)) + " items in, " + str (size_t (s.items_out)) + " out; busy " + percent (busy, elapsed)
+            + ", waiting on input " + percent (input_wait, elapsed) + ", blocked on output " + percent (output_wait, elapsed));
+      }
+      for (const auto& q : queues) {
+        const uint64_t samples = q.samples;
+        INFO ("  queue \"" + q.name + "\": mean occupancy " + str (samples ? double (q.occupancy) / samples : 0.0, 3)
+            + " of " + str (q.capacity) + ", full " + percent (q.full, samples) + " of the time");
+      }
+
+      const std::string path = queue_profile_file();
+      if (path.empty())
+        return;
+
+      nlohmann::json json;
+      json["command"] = App::NAME;
+      json["nthreads"] = number_of_threads();
+      json["wall_time"] = seconds (wall_time);
+      for (const auto& s : stages) {
+        nlohmann::json stage;
+        stage["name"] = s.name;
+        stage["threads"] = size_t (s.threads);
+        stage["items_in"] = size_t (s.items_in);
+        stage["items_out"] = size_t (s.items_out);
+        stage["thread_time"] = seconds (s.elapsed);
+        stage["busy"] = seconds (s.busy);
+        stage["input_wait"] = seconds (s.input_wait);
+        stage["output_wait"] = seconds (s.output_wait);
+        json["stages"].push_back (stage);
+      }
+      for (const auto& q : queues) {
+        nlohmann::json queue;
+        queue["name"] = q.name;
+        queue["capacity"] = q.capacity;
+        queue["samples"] = uint64_t (q.samples);
+        queue["mean_occupancy"] = q.samples ? double (q.occupancy) / q.samples : 0.0;
+        queue["full_samples"] = uint64_t (q.full);
+        json["queues"].push_back (queue);
+      }
+
+      static std::mutex mutex;
+      std::lock_guard<std::mutex> lock (mutex);
+      File::OFStream out (path, std::ios_base::out | std::ios_base::app);
+      out << json.dump() << "\n";
+    }
+
+
+
+
+
     void (*__Backend::previous_print_func) (const std::string& msg) = nullptr;
     void (*__Backend::previous_report_to_user_func) (const std::string& msg, int type) = nullptr;
 
@@ -19,6 +19,7 @@
 #include <thread>
 #include <future>
 #include <mutex>
+#include <functional>
 
 #include "debug.h"
 #include "mrtrix.h"
@@ -54,6 +55,8 @@
 
 namespace MR
 {
+  namespace App { class Option; }
+
   namespace Thread
   {
 
@@ -91,6 +94,22 @@ namespace MR
     };
 
 
+    //! \cond skip
+    //! run \a task on a worker thread from the process-wide thread pool
+    /*! Worker threads are created as needed, and kept alive once their task
+     * has completed so that they can be reused for subsequent tasks. This
+     * avoids the cost of creating and destroying threads for each parallel
+     * operation, which can be significant for iterative algorithms that
+     * launch many short-lived parallel operations. A new worker is created
+     * whenever no idle worker is available, so that all tasks submitted run
+     * concurrently (as they may depend on each other, e.g. in a
+     * Thread::run_queue() pipeline). Any exception thrown by \a task is
+     * passed on via the future returned. The \a name is used to label the
+     * task in the execution profile (see the -profile option). */
+    std::future<void> __launch (std::function<void()>&& task, const std::string& name);
+    //! \endcond
+
+
     namespace {
 
       class __thread_base { NOMEMALIGN
@@ -113,7 +132,8 @@ namespace MR
             __thread_base (name) {
               DEBUG ("launching thread \"" + name + "\"...");
               using F = typename std::remove_reference<Functor>::type;
-              thread = std::async (std::launch::async, &F::execute, &functor);
+              F* f = &functor;
+              thread = __launch ([f] () { f->execute(); }, name);
             }
           __single_thread (const __single_thread&) = delete;
           __single_thread (__single_thread&&) = default;
@@ -144,9 +164,12 @@ namespace MR
                 DEBUG ("launching " + str (nthreads) + " threads \"" + name + "\"...");
                 using F = typename std::remove_reference<Functor>::type;
                 threads.reserve (nthreads);
-                for (auto& f : functors)
-                  threads.push_back (std::async (std::launch::async, &F::execute, &f));
-                threads.push_back (std::async (std::launch::async, &F::execute, &functor));
+                for (auto& f : functors) {
+                  F* p = &f;
+                  threads.push_back (__launch ([p] () { p->execute(); }, name));
+                }
+                F* p = &functor;
+                threads.push_back (__launch ([p] () { p->execute(); }, name));
               }
 
             __multi_thread (const __multi_thread&) = delete;
@@ -250,6 +273,23 @@ namespace MR
     nthreads_t type_nthreads ();
 
 
+    /*! command-line option to set the CPU affinity of worker threads, for
+     * commands where this may be worthwhile (overrides the ThreadAffinity
+     * configuration file entry). */
+    extern const App::Option AffinityOption;
+
+    /*! the NUMA node that the calling thread has been pinned to, or -1 if
+     * the thread has not been pinned (see the ThreadAffinity configuration
+     * file entry). */
+    int numa_node ();
+
+    /*! the number of distinct NUMA nodes that worker threads are pinned to
+     * (1 if threads are not pinned). Read-only data that are accessed
+     * intensively by all threads may be worth replicating on each node if
+     * this is greater than one. */
+    size_t num_numa_nodes ();
+
+
 
     //! used to request multiple threads of the corresponding functor
     /*! This function is used in combination with Thread::run or
@@ -17,6 +17,10 @@
 #define __mrtrix_thread_queue_h__
 
 #include <stack>
+#include <deque>
+#include <atomic>
+#include <chrono>
+#include <cmath>
 #include <condition_variable>
 
 #include "exception.h"
@@ -25,6 +29,14 @@
 
 #define MRTRIX_QUEUE_DEFAULT_CAPACITY 128
 #define MRTRIX_QUEUE_DEFAULT_BATCH_SIZE 128
+// number of attempts made by LockFreeQueue before blocking:
+#define MRTRIX_QUEUE_SPIN_COUNT 64
+// batch size used to request adaptive batching in Thread::batch():
+#define MRTRIX_QUEUE_ADAPTIVE_BATCH 0
+// with adaptive batching, the time taken to fill each batch (in ns) that
+// batch sizes are adjusted towards, and the largest batch size allowed:
+#define MRTRIX_QUEUE_ADAPTIVE_BATCH_TARGET_TIME 500000
+#define MRTRIX_QUEUE_ADAPTIVE_BATCH_MAX_SIZE 1024
 
 namespace MR
 {
@@ -523,6 +535,12 @@ namespace MR
                     << reader_count << " reader" << (reader_count > 1 ? "s" : "") << ", items waiting: " << size() << "\n";
         }
 
+        //! the number of items currently waiting in the queue
+        size_t occupancy () {
+          std::lock_guard<std::mutex> lock (mutex);
+          return size();
+        }
+
 
       private:
         std::mutex mutex;
@@ -627,28 +645,354 @@ namespace MR
 
 
 
+    //! A first-in first-out thread-safe item queue, without locking
+    /*! This class provides the same interface as Thread::Queue, but is
+     * implemented as a bounded multi-producer multi-consumer ring buffer,
+     * such that pushing and popping items does not require any locking.
+     * Threads only block (on a mutex and condition variable) if the queue is
+     * genuinely empty or full, after a brief period of retrying.
+     *
+     * The ring buffer holds \a buffer_size items, preallocated on
+     * construction. Rather than passing pointers to items, each
+     * Writer::Item and Reader::Item holds its own item, which is swapped
+     * with the corresponding item in the buffer on each write() or read().
+     * Items are therefore recycled as with Thread::Queue (the item obtained
+     * after a write() will contain stale data from a previous iteration),
+     * without any further memory allocation. This requires that \c T be
+     * default-constructible and efficiently swappable (i.e.
+     * nothrow-movable).
+     *
+     * Thread::run_queue() uses this class automatically for all item types
+     * that meet these requirements, including batches of items (see
+     * Thread::batch()).
+     *
+     * \sa Thread::Queue */
+    template <class T> class LockFreeQueue { NOMEMALIGN
+      public:
+        LockFreeQueue (const std::string& description = "unnamed", size_t buffer_size = MRTRIX_QUEUE_DEFAULT_CAPACITY) :
+          capacity (buffer_size),
+          slots (new Slot [buffer_size]),
+          name (description) { init(); }
+
+        //! needed for Thread::run_queue()
+        LockFreeQueue (const T& /*item_type*/, const std::string& description = "unnamed", size_t buffer_size = MRTRIX_QUEUE_DEFAULT_CAPACITY) :
+          capacity (buffer_size),
+          slots (new Slot [buffer_size]),
+          name (description) { init(); }
+
+
+        class Writer { NOMEMALIGN
+          public:
+            Writer (LockFreeQueue<T>& queue) : Q (queue) {
+              Q.register_writer();
+            }
+            Writer (const Writer& W) : Q (W.Q) {
+              Q.register_writer();
+            }
+
+            class Item { NOMEMALIGN
+              public:
+                Item (const Writer& writer) : Q (writer.Q), p (new T) { }
+                ~Item () {
+                  Q.unregister_writer();
+                }
+                FORCE_INLINE bool write () {
+                  return Q.push (*p);
+                }
+                FORCE_INLINE T& operator*() const throw ()   {
+                  return *p;
+                }
+                FORCE_INLINE T* operator->() const throw ()  {
+                  return p.get();
+                }
+              private:
+                LockFreeQueue<T>& Q;
+                std::unique_ptr<T> p;
+            };
+
+          private:
+            LockFreeQueue<T>& Q;
+        };
+
+
+        class Reader { NOMEMALIGN
+          public:
+            Reader (LockFreeQueue<T>& queue) : Q (queue) {
+              Q.register_reader();
+            }
+            Reader (const Reader& reader) : Q (reader.Q) {
+              Q.register_reader();
+            }
+
+            class Item { NOMEMALIGN
+              public:
+                Item (const Reader& reader) : Q (reader.Q), p (new T), valid (false) { }
+                ~Item () {
+                  Q.unregister_reader();
+                }
+                FORCE_INLINE bool read () {
+                  return (valid = Q.pop (*p));
+                }
+                FORCE_INLINE T& operator*() const throw ()   {
+                  return *p;
+                }
+                FORCE_INLINE T* operator->() const throw ()  {
+                  return p.get();
+                }
+                FORCE_INLINE bool operator! () const throw () {
+                  return !valid;
+                }
+              private:
+                LockFreeQueue<T>& Q;
+                std::unique_ptr<T> p;
+                bool valid;
+            };
+          private:
+            LockFreeQueue<T>& Q;
+        };
+
+        //! Print out a status report for debugging purposes
+        void status () {
+          const size_t writers = writer_count, readers = reader_count;
+          const size_t back = enqueue_pos, front = dequeue_pos;
+          std::cerr << "Thread::LockFreeQueue \"" + name + "\": "
+                    << writers << " writer" << (writers > 1 ? "s" : "") << ", "
+                    << readers << " reader" << (readers > 1 ? "s" : "") << ", items waiting: "
+                    << (back > front ? back - front : 0) << "\n";
+        }
+
+        //! the (approximate) number of items currently waiting in the queue
+        size_t occupancy () const {
+          const size_t back = enqueue_pos, front = dequeue_pos;
+          return back > front ? back - front : 0;
+        }
+
+
+      private:
+        // each slot holds an item, and a sequence number indicating whether
+        // it is ready to be written to (seq == position) or read from
+        // (seq == position+1) for a given position in the queue:
+        struct Slot { MEMALIGN(Slot)
+          std::atomic<size_t> seq;
+          T item;
+        };
+
+        // positions are kept on separate cache lines to avoid false sharing:
+        alignas(64) std::atomic<size_t> enqueue_pos;
+        alignas(64) std::atomic<size_t> dequeue_pos;
+        alignas(64) std::atomic<size_t> writer_count, reader_count;
+        std::atomic<size_t> writers_waiting, readers_waiting;
+        const size_t capacity;
+        std::unique_ptr<Slot[]> slots;
+        std::mutex mutex;
+        std::condition_variable more_data, more_space;
+        std::string name;
+
+        LockFreeQueue (const LockFreeQueue&) = delete;
+        LockFreeQueue& operator= (const LockFreeQueue&) = delete;
+
+        void init () {
+          assert (capacity > 0);
+          for (size_t n = 0; n < capacity; ++n)
+            slots[n].seq.store (n, std::memory_order_relaxed);
+          enqueue_pos = dequeue_pos = 0;
+          writer_count = reader_count = 0;
+          writers_waiting = readers_waiting = 0;
+        }
+
+        void register_writer () { ++writer_count; }
+        void register_reader () { ++reader_count; }
+
+        void unregister_writer () {
+          assert (writer_count);
+          if (--writer_count == 0) {
+            DEBUG ("no writers left on queue \"" + name + "\"");
+            std::lock_guard<std::mutex> lock (mutex);
+            more_data.notify_all();
+          }
+        }
+        void unregister_reader () {
+          assert (reader_count);
+          if (--reader_count == 0) {
+            DEBUG ("no readers left on queue \"" + name + "\"");
+            std::lock_guard<std::mutex> lock (mutex);
+            more_space.notify_all();
+          }
+        }
+
+        // the slot at position pos, and the difference between its sequence
+        // number and the value expected if ready for access:
+        FORCE_INLINE Slot& slot (size_t pos, size_t expected, ssize_t& diff) const {
+          Slot& s (slots[pos % capacity]);
+          diff = ssize_t (s.seq.load (std::memory_order_acquire)) - ssize_t (expected);
+          return s;
+        }
+
+        FORCE_INLINE bool try_push (T& item) {
+          size_t pos = enqueue_pos.load (std::memory_order_relaxed);
+          while (true) {
+            ssize_t diff;
+            Slot& s (slot (pos, pos, diff));
+            if (diff == 0) {
+              if (enqueue_pos.compare_exchange_weak (pos, pos+1, std::memory_order_relaxed)) {
+                std::swap (s.item, item);
+                s.seq.store (pos+1, std::memory_order_release);
+                return true;
+              }
+            }
+            else if (diff < 0)
+              return false;
+            else
+              pos = enqueue_pos.load (std::memory_order_relaxed);
+          }
+        }
+
+        FORCE_INLINE bool try_pop (T& item) {
+          size_t pos = dequeue_pos.load (std::memory_order_relaxed);
+          while (true) {
+            ssize_t diff;
+            Slot& s (slot (pos, pos+1, diff));
+            if (diff == 0) {
+              if (dequeue_pos.compare_exchange_weak (pos, pos+1, std::memory_order_relaxed)) {
+                std::swap (s.item, item);
+                s.seq.store (pos+capacity, std::memory_order_release);
+                return true;
+              }
+            }
+            else if (diff < 0)
+              return false;
+            else
+              pos = dequeue_pos.load (std::memory_order_relaxed);
+          }
+        }
+
+        FORCE_INLINE bool can_push () const {
+          ssize_t diff;
+          const size_t pos = enqueue_pos.load (std::memory_order_relaxed);
+          slot (pos, pos, diff);
+          return diff >= 0;
+        }
+        FORCE_INLINE bool can_pop () const {
+          ssize_t diff;
+          const size_t pos = dequeue_pos.load (std::memory_order_relaxed);
+          slot (pos, pos+1, diff);
+          return diff >= 0;
+        }
+
+        // wake up any threads blocked waiting on condition:
+        FORCE_INLINE void notify (std::atomic<size_t>& waiting, std::condition_variable& condition) {
+          std::atomic_thread_fence (std::memory_order_seq_cst);
+          if (waiting.load (std::memory_order_relaxed)) {
+            std::lock_guard<std::mutex> lock (mutex);
+            condition.notify_all();
+          }
+        }
+
+        bool push (T& item) {
+          for (size_t attempt = 0; ; ++attempt) {
+            if (!reader_count)
+              return false;
+            if (try_push (item)) {
+              notify (readers_waiting, more_data);
+              return true;
+            }
+            if (attempt < MRTRIX_QUEUE_SPIN_COUNT) {
+              std::this_thread::yield();
+              continue;
+            }
+            std::unique_lock<std::mutex> lock (mutex);
+            ++writers_waiting;
+            std::atomic_thread_fence (std::memory_order_seq_cst);
+            if (!can_push() && reader_count)
+              more_space.wait (lock);
+            --writers_waiting;
+          }
+        }
+
+        bool pop (T& item) {
+          for (size_t attempt = 0; ; ++attempt) {
+            if (try_pop (item)) {
+              notify (writers_waiting, more_space);
+              return true;
+            }
+            if (!writer_count) {
+              // items may have been pushed before the last writer left:
+              if (try_pop (item))
+                return true;
+              return false;
+            }
+            if (attempt < MRTRIX_QUEUE_SPIN_COUNT) {
+              std::this_thread::yield();
+              continue;
+            }
+            std::unique_lock<std::mutex> lock (mutex);
+            ++readers_waiting;
+            std::atomic_thread_fence (std::memory_order_seq_cst);
+            if (!can_pop() && writer_count)
+              more_data.wait (lock);
+            --readers_waiting;
+          }
+        }
+    };
+
+
+
+    //! \cond skip
+
+    // use LockFreeQueue wherever the item type allows it (its buffer
+    // cannot honour alignment requirements beyond those of MEMALIGN):
+    template <class T>
+      struct __queue_type { NOMEMALIGN
+        using type = typename std::conditional<
+          std::is_default_constructible<T>::value &&
+          std::is_nothrow_move_constructible<T>::value &&
+          std::is_nothrow_move_assignable<T>::value &&
+          alignof(T) <= EIGEN_DEFAULT_ALIGN_BYTES,
+          LockFreeQueue<T>, Queue<T>>::type;
+      };
+
+    template <class T>
+      struct __queue_type<__Batch<T>> { NOMEMALIGN
+        using type = Queue<__Batch<T>>;
+      };
+
+    //! \endcond
+
+
+
      //* \cond skip
 
+    // whether Thread::batch() without an explicit batch size should adjust
+    // the batch size at runtime (QueueAdaptiveBatching config file entry):
+    bool __adaptive_batching ();
+
     template <class T> class Queue<__Batch<T>> { NOMEMALIGN
       private:
         using BatchType = vector<T>;
-        using BatchQueue = Queue<BatchType>;
+        using BatchQueue = typename __queue_type<BatchType>::type;
 
       public:
         Queue (const __Batch<T>& item_type, const std::string& description = "unnamed", size_t buffer_size = MRTRIX_QUEUE_DEFAULT_CAPACITY) :
           batch_queue (description, buffer_size),
-          batch_size (item_type.num) { }
+          batch_size (item_type.num == MRTRIX_QUEUE_ADAPTIVE_BATCH && !__adaptive_batching() ?
+              MRTRIX_QUEUE_DEFAULT_BATCH_SIZE : item_type.num),
+          capacity (buffer_size) { }
 
 
         class Writer { NOMEMALIGN
           public:
             Writer (Queue<__Batch<T>>& queue) :
-              batch_writer (queue.batch_queue), batch_size (queue.batch_size) { }
+              batch_writer (queue.batch_queue), queue (queue) { }
 
             class Item { NOMEMALIGN
               public:
                 Item (const Writer& writer) :
-                  batch_item (writer.batch_writer), batch_size (writer.batch_size), n (0) {
+                  batch_item (writer.batch_writer),
+                  queue (writer.queue),
+                  adaptive (queue.batch_size == MRTRIX_QUEUE_ADAPTIVE_BATCH),
+                  batch_size (adaptive ? 1 : queue.batch_size),
+                  n (0),
+                  start (clock::now()) {
                     batch_item->resize (batch_size);
                 }
                 ~Item () {
@@ -659,8 +1003,11 @@ namespace MR
                 }
                 FORCE_INLINE bool write () {
                   if (++n >= batch_size) {
+                    const clock::time_point filled = adaptive ? clock::now() : start;
                     if (!batch_item.write())
                       return false;
+                    if (adaptive)
+                      adapt (filled);
                     n = 0;
                     batch_item->resize (batch_size);
                   }
@@ -673,14 +1020,40 @@ namespace MR
                   return &((*batch_item)[n]);
                 }
               private:
+                using clock = std::chrono::steady_clock;
                 typename BatchQueue::Writer::Item batch_item;
-                const size_t batch_size;
+                Queue<__Batch<T>>& queue;
+                const bool adaptive;
+                size_t batch_size;
                 size_t n;
+                clock::time_point start;
+
+                // Move the size of the next batch towards that which would
+                // take MRTRIX_QUEUE_ADAPTIVE_BATCH_TARGET_TIME to fill, given
+                // the time per item taken to fill the last one (excluding
+                // time blocked on the queue). If readers are keeping up (the
+                // queue is empty once the batch is pushed), smaller batches
+                // spread the work more evenly between them; if the queue is
+                // filling up, larger batches reduce their per-batch overhead.
+                void adapt (const clock::time_point& filled) {
+                  const double time_per_item = std::chrono::duration<double,std::nano> (filled - start).count() / n;
+                  double target = MRTRIX_QUEUE_ADAPTIVE_BATCH_TARGET_TIME;
+                  const size_t occupancy = queue.occupancy();
+                  if (!occupancy)
+                    target /= 2.0;
+                  else if (2*occupancy >= queue.capacity)
+                    target *= 2.0;
+                  const double ideal = time_per_item > 0.0 ? target / time_per_item : double (MRTRIX_QUEUE_ADAPTIVE_BATCH_MAX_SIZE);
+                  // only go halfway, to damp fluctuations in the timings:
+                  const double next = std::round (0.5 * (batch_size + std::min (ideal, double (MRTRIX_QUEUE_ADAPTIVE_BATCH_MAX_SIZE))));
+                  batch_size = std::max (size_t (next), size_t (1));
+                  start = clock::now();
+                }
             };
 
           private:
             typename BatchQueue::Writer batch_writer;
-            const size_t batch_size;
+            Queue<__Batch<T>>& queue;
         };
 
 
@@ -720,11 +1093,14 @@ namespace MR
         };
 
         FORCE_INLINE void status () { batch_queue.status(); }
+        //! the number of batches currently waiting in the queue
+        FORCE_INLINE size_t occupancy () { return batch_queue.occupancy(); }
 
 
       private:
         BatchQueue batch_queue;
         const size_t batch_size;
+        const size_t capacity;
     };
 
 
@@ -733,6 +1109,120 @@ namespace MR
 
 
 
+    //! \cond skip
+
+    // optional instrumentation of the stages and queues of a
+    // Thread::run_queue() pipeline - see Thread::__QueueProfile::enabled()
+    // for details of how to switch it on. Each stage accumulates the time its
+    // threads spend in the functor itself (busy), waiting for items from an
+    // empty input queue (input wait), and blocked on a full output queue
+    // (output wait); the occupancy of each queue is sampled after every
+    // write. Timings are kept per thread and only merged when the thread
+    // completes, so the overhead is limited to the clock calls.
+    class __QueueProfile { NOMEMALIGN
+      public:
+        using clock = std::chrono::steady_clock;
+
+        class Stage { NOMEMALIGN
+          public:
+            Stage (const std::string& name) :
+              name (name), threads (0), items_in (0), items_out (0),
+              elapsed (0), busy (0), input_wait (0), output_wait (0) { }
+
+            const std::string name;
+            std::atomic<size_t> threads, items_in, items_out;
+            // all times in nanoseconds, summed over threads:
+            std::atomic<uint64_t> elapsed, busy, input_wait, output_wait;
+        };
+
+        class Queue { NOMEMALIGN
+          public:
+            Queue (const std::string& name, size_t capacity) :
+              name (name), capacity (capacity), samples (0), occupancy (0), full (0) { }
+
+            FORCE_INLINE void sample (size_t num_items) {
+              ++samples;
+              occupancy += num_items;
+              if (num_items >= capacity)
+                ++full;
+            }
+
+            const std::string name;
+            const size_t capacity;
+            std::atomic<uint64_t> samples, occupancy, full;
+        };
+
+        // per-thread accumulator, merged into its Stage on destruction:
+        class Timer { NOMEMALIGN
+          public:
+            Timer (Stage& stage) :
+              stage (stage), start (clock::now()), last (start),
+              items_in (0), items_out (0), busy (0), input_wait (0), output_wait (0) { ++stage.threads; }
+            ~Timer () {
+              stage.items_in += items_in;
+              stage.items_out += items_out;
+              stage.busy += busy;
+              stage.input_wait += input_wait;
+              stage.output_wait += output_wait;
+              stage.elapsed += std::chrono::duration_cast<std::chrono::nanoseconds> (clock::now() - start).count();
+            }
+
+            FORCE_INLINE void done_read (bool success) { input_wait += lap(); items_in += success; }
+            FORCE_INLINE void done_work () { busy += lap(); }
+            FORCE_INLINE void done_write (bool success) { output_wait += lap(); items_out += success; }
+
+          private:
+            Stage& stage;
+            const clock::time_point start;
+            clock::time_point last;
+            size_t items_in, items_out;
+            uint64_t busy, input_wait, output_wait;
+
+            FORCE_INLINE uint64_t lap () {
+              const auto now = clock::now();
+              const uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds> (now - last).count();
+              last = now;
+              return ns;
+            }
+        };
+
+        __QueueProfile () : active (enabled()), start (clock::now()) { }
+
+        //! a new Stage to be monitored, or nullptr if profiling is disabled
+        Stage* stage (const std::string& name) {
+          if (!active) return nullptr;
+          stages.emplace_back (name);
+          return &stages.back();
+        }
+        //! a new Queue to be monitored, or nullptr if profiling is disabled
+        Queue* queue (const std::string& name, size_t capacity) {
+          if (!active) return nullptr;
+          queues.emplace_back (name, capacity);
+          return &queues.back();
+        }
+
+        //! display summary at INFO level, and append to JSON file if requested
+        void report () const;
+
+        //! whether run_queue() pipelines should be profiled
+        /*! This is the case if the \c MRTRIX_QUEUE_PROFILE environment
+         * variable is set to a non-zero value, if the \c QueueProfile config
+         * file entry is true, or if an output file for the results has been
+         * set via the \c MRTRIX_QUEUE_PROFILE_FILE environment variable or
+         * the \c QueueProfileFile config file entry. */
+        static bool enabled ();
+
+      private:
+        const bool active;
+        const clock::time_point start;
+        std::deque<Stage> stages;
+        std::deque<Queue> queues;
+    };
+
+    //! \endcond
+
+
+
     /*! wrapper classes to extend simple functors designed for use with
      * Thread::run_queue with functionality needed for use with Thread::Queue */
     namespace {
@@ -741,11 +1231,15 @@ namespace MR
        template <class Type, class Functor>
          class __Source { MEMALIGN(__Source<Type,Functor>)
            public:
-             __Source (Queue<Type>& queue, Functor& functor) :
-               writer (queue), func (__job<Functor>::functor (functor)) { }
+             __Source (typename __queue_type<Type>::type& queue, Functor& functor,
+                 __QueueProfile::Stage* stage = nullptr, __QueueProfile::Queue* queue_profile = nullptr) :
+               writer (queue), func (__job<Functor>::functor (functor)),
+               queue (queue), stage (stage), queue_profile (queue_profile) { }
 
              void execute () {
-               typename Queue<Type>::Writer::Item out (writer);
+               if (stage)
+                 return execute_profiled();
+               typename __queue_type<Type>::type::Writer::Item out (writer);
                do {
                  if (!func (*out))
                    return;
@@ -753,20 +1247,43 @@ namespace MR
              }
 
            private:
-             typename Queue<Type>::Writer writer;
+             typename __queue_type<Type>::type::Writer writer;
              typename __job<Functor>::member_type func;
+             typename __queue_type<Type>::type& queue;
+             __QueueProfile::Stage* stage;
+             __QueueProfile::Queue* queue_profile;
+
+             void execute_profiled () {
+               __QueueProfile::Timer timer (*stage);
+               typename __queue_type<Type>::type::Writer::Item out (writer);
+               while (true) {
+                 const bool more = func (*out);
+                 timer.done_work();
+                 if (!more)
+                   return;
+                 const bool written = out.write();
+                 timer.done_write (written);
+                 queue_profile->sample (queue.occupancy());
+                 if (!written)
+                   return;
+               }
+             }
          };
 
 
        template <class Type1, class Functor, class Type2>
          class __Pipe { MEMALIGN(__Pipe<Type1,Functor,Type2>)
            public:
-             __Pipe (Queue<Type1>& queue_in, Functor& functor, Queue<Type2>& queue_out) :
-               reader (queue_in), writer (queue_out), func (__job<Functor>::functor (functor)) { }
+             __Pipe (typename __queue_type<Type1>::type& queue_in, Functor& functor, typename __queue_type<Type2>::type& queue_out,
+                 __QueueProfile::Stage* stage = nullptr, __QueueProfile::Queue* queue_profile = nullptr) :
+               reader (queue_in), writer (queue_out), func (__job<Functor>::functor (functor)),
+               queue_out (queue_out), stage (stage), queue_profile (queue_profile) { }
 
              void execute () {
-               typename Queue<Type1>::Reader::Item in (reader);
-               typename Queue<Type2>::Writer::Item out (writer);
+               if (stage)
+                 return execute_profiled();
+               typename __queue_type<Type1>::type::Reader::Item in (reader);
+               typename __queue_type<Type2>::type::Writer::Item out (writer);
                do {
                  do { if (!in.read()) return; }
                  while (!func (*in, *out));
@@ -774,9 +1291,33 @@ namespace MR
              }
 
            private:
-             typename Queue<Type1>::Reader reader;
-             typename Queue<Type2>::Writer writer;
+             typename __queue_type<Type1>::type::Reader reader;
+             typename __queue_type<Type2>::type::Writer writer;
              typename __job<Functor>::member_type func;
+             typename __queue_type<Type2>::type& queue_out;
+             __QueueProfile::Stage* stage;
+             __QueueProfile::Queue* queue_profile;
+
+             void execute_profiled () {
+               __QueueProfile::Timer timer (*stage);
+               typename __queue_type<Type1>::type::Reader::Item in (reader);
+               typename __queue_type<Type2>::type::Writer::Item out (writer);
+               while (true) {
+                 const bool read = in.read();
+                 timer.done_read (read);
+                 if (!read)
+                   return;
+                 const bool keep = func (*in, *out);
+                 timer.done_work();
+                 if (keep) {
+                   const bool written = out.write();
+                   timer.done_write (written);
+                   queue_profile->sample (queue_out.occupancy());
+                   if (!written)
+                     return;
+                 }
+               }
+             }
          };
 
 
@@ -784,11 +1325,14 @@ namespace MR
        template <class Type, class Functor>
          class __Sink { MEMALIGN(__Sink<Type,Functor>)
            public:
-             __Sink (Queue<Type>& queue, Functor& functor) :
-               reader (queue), func (__job<Functor>::functor (functor)) { }
+             __Sink (typename __queue_type<Type>::type& queue, Functor& functor,
+                 __QueueProfile::Stage* stage = nullptr) :
+               reader (queue), func (__job<Functor>::functor (functor)), stage (stage) { }
 
              void execute () {
-               typename Queue<Type>::Reader::Item in (reader);
+               if (stage)
+                 return execute_profiled();
+               typename __queue_type<Type>::type::Reader::Item in (reader);
                while (in.read()) {
                  if (!func (*in))
                    return;
@@ -796,8 +1340,24 @@ namespace MR
              }
 
            private:
-             typename Queue<Type>::Reader reader;
+             typename __queue_type<Type>::type::Reader reader;
              typename __job<Functor>::member_type func;
+             __QueueProfile::Stage* stage;
+
+             void execute_profiled () {
+               __QueueProfile::Timer timer (*stage);
+               typename __queue_type<Type>::type::Reader::Item in (reader);
+               while (true) {
+                 const bool read = in.read();
+                 timer.done_read (read);
+                 if (!read)
+                   return;
+                 const bool more = func (*in);
+                 timer.done_work();
+                 if (!more)
+                   return;
+               }
+             }
          };
 
 
@@ -813,11 +1373,12 @@ namespace MR
 
     //! used to request batched processing of items
     /*! This function is used in combination with Thread::run_queue to request
-     * that the items \a object be processed in batches of \a number items
-     * (defaults to MRTRIX_QUEUE_DEFAULT_BATCH_SIZE).
+     * that the items \a object be processed in batches of \a number items.
+     * By default, the batch size is adjusted at runtime (see \ref
+     * thread_run_queue_batch).
      * \sa Thread::run_queue() */
     template <class Item>
-      inline __Batch<Item> batch (const Item&, size_t number = MRTRIX_QUEUE_DEFAULT_BATCH_SIZE)
+      inline __Batch<Item> batch (const Item&, size_t number = MRTRIX_QUEUE_ADAPTIVE_BATCH)
       {
         return __Batch<Item> (number);
       }
@@ -988,8 +1549,13 @@ namespace MR
      * }
      * \endcode
      *
-     * By default, batches consist of MRTRIX_QUEUE_DEFAULT_BATCH_SIZE items
-     * (defined as 128). This can be set explicitly by providing the desired
+     * By default, the size of each batch is adjusted at runtime by each
+     * writer thread, based on the time taken per item to fill the previous
+     * batch and the occupancy of the queue, aiming for batches that take
+     * around MRTRIX_QUEUE_ADAPTIVE_BATCH_TARGET_TIME to fill. This can be
+     * disabled via the QueueAdaptiveBatching config file entry, in which
+     * case batches consist of MRTRIX_QUEUE_DEFAULT_BATCH_SIZE items (defined
+     * as 128). The size can also be set explicitly by providing the desired
      * size as an additional argument to Thread::batch():
      *
      * \code
@@ -1006,6 +1572,17 @@ namespace MR
      *
      * Obviously, Thread::multi() and Thread::batch() can be used in any
      * combination to perform the operations required.
+     *
+     * \section thread_run_queue_profile Profiling
+     *
+     * To identify which stage of a pipeline is the bottleneck, set the
+     * MRTRIX_QUEUE_PROFILE environment variable (or the QueueProfile config
+     * file entry). Each stage then records the time its threads spend
+     * processing items, waiting on an empty input queue, and blocked on a
+     * full output queue, along with the mean occupancy of each queue. A
+     * summary is displayed at the end of the pipeline at \c -info level, and
+     * appended as a line of JSON to the file named by
+     * MRTRIX_QUEUE_PROFILE_FILE (or QueueProfileFile) if set.
      */
 
     template <class Source, class Type, class Sink>
@@ -1023,9 +1600,10 @@ namespace MR
           return;
         }
 
-         Queue<Type> queue (item_type, "source->sink", capacity);
-         __Source<Type,Source> source_functor (queue, source);
-         __Sink<Type,Sink>     sink_functor   (queue, sink);
+         __QueueProfile profile;
+         typename __queue_type<Type>::type queue (item_type, "source->sink", capacity);
+         __Source<Type,Source> source_functor (queue, source, profile.stage ("source"), profile.queue ("source->sink", capacity));
+         __Sink<Type,Sink>     sink_functor   (queue, sink, profile.stage ("sink"));
 
         auto t1 = run (__job<Source>::get (source, source_functor), "source");
         auto t2 = run (__job<Sink>::get (sink, sink_functor), "sink");
@@ -1033,6 +1611,7 @@ namespace MR
         t1.wait();
         t2.wait();
 
+        profile.report();
         check_app_exit_code();
       }
 
@@ -1103,12 +1682,13 @@ namespace MR
         }
 
 
-        Queue<Type1> queue1 (item_type1, "source->pipe", capacity);
-        Queue<Type2> queue2 (item_type2, "pipe->sink", capacity);
+        typename __queue_type<Type1>::type queue1 (item_type1, "source->pipe", capacity);
+        typename __queue_type<Type2>::type queue2 (item_type2, "pipe->sink", capacity);
 
-        __Source<Type1,Source>   source_functor (queue1, source);
-        __Pipe<Type1,Pipe,Type2> pipe_functor   (queue1, pipe, queue2);
-        __Sink<Type2,Sink>       sink_functor   (queue2, sink);
+        __QueueProfile profile;
+        __Source<Type1,Source>   source_functor (queue1, source, profile.stage ("source"), profile.queue ("source->pipe", capacity));
+        __Pipe<Type1,Pipe,Type2> pipe_functor   (queue1, pipe, queue2, profile.stage ("pipe"), profile.queue ("pipe->sink", capacity));
+        __Sink<Type2,Sink>       sink_functor   (queue2, sink, profile.stage ("sink"));
 
         auto t1 = run (__job<Source>::get (source, source_functor), "source");
         auto t2 = run (__job<Pipe>::get (pipe, pipe_functor), "pipe");
@@ -1118,6 +1698,7 @@ namespace MR
         t2.wait();
         t3.wait();
 
+        profile.report();
         check_app_exit_code();
       }
 
@@ -1151,14 +1732,15 @@ namespace MR
         }
 
 
-        Queue<Type1> queue1 (item_type1, "source->pipe", capacity);
-        Queue<Type2> queue2 (item_type2, "pipe->pipe", capacity);
-        Queue<Type3> queue3 (item_type3, "pipe->sink", capacity);
+        typename __queue_type<Type1>::type queue1 (item_type1, "source->pipe", capacity);
+        typename __queue_type<Type2>::type queue2 (item_type2, "pipe->pipe", capacity);
+        typename __queue_type<Type3>::type queue3 (item_type3, "pipe->sink", capacity);
 
-        __Source<Type1,Source>    source_functor (queue1, source);
-        __Pipe<Type1,Pipe1,Type2> pipe1_functor   (queue1, pipe1, queue2);
-        __Pipe<Type2,Pipe2,Type3> pipe2_functor   (queue2, pipe2, queue3);
-        __Sink<Type3,Sink>        sink_functor   (queue3, sink);
+        __QueueProfile profile;
+        __Source<Type1,Source>    source_functor (queue1, source, profile.stage ("source"), profile.queue ("source->pipe", capacity));
+        __Pipe<Type1,Pipe1,Type2> pipe1_functor   (queue1, pipe1, queue2, profile.stage ("pipe1"), profile.queue ("pipe->pipe", capacity));
+        __Pipe<Type2,Pipe2,Type3> pipe2_functor   (queue2, pipe2, queue3, profile.stage ("pipe2"), profile.queue ("pipe->sink", capacity));
+        __Sink<Type3,Sink>        sink_functor   (queue3, sink, profile.stage ("sink"));
 
         auto t1 = run (__job<Source>::get (source, source_functor), "source");
         auto t2 = run (__job<Pipe1>::get (pipe1, pipe1_functor), "pipe1");
@@ -1170,6 +1752,7 @@ namespace MR
         t3.wait();
         t4.wait();
 
+        profile.report();
         check_app_exit_code();
       }
 
@@ -180,7 +180,7 @@ namespace MR
         {
           Mapping::TrackLoader loader (file, count);
           TrackMappingWorker worker (*this, Mapping::determine_upsample_ratio (Fixel_map<Fixel>::header(), properties, 0.1));
-          Thread::run_queue (loader,
+          Thread::run_queue (Thread::multi (loader, loader.num_threads()),
                              Thread::batch (Tractography::Streamline<>()),
                              Thread::multi (worker));
         }
@@ -244,7 +244,7 @@ namespace MR
           mapper.set_upsample_ratio (Mapping::determine_upsample_ratio (Fixel_map<Fixel>::header(), properties, 0.1));
           mapper.set_use_precise_mapping (true);
           Thread::run_queue (
-              loader,
+              Thread::multi (loader, loader.num_threads()),
               Thread::batch (Tractography::Streamline<float>()),
               Thread::multi (mapper),
               Thread::batch (Mapping::SetDixel()),
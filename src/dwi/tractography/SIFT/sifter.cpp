@@ -22,6 +22,7 @@
 #include "algo/loop.h"
 
 #include "dwi/tractography/file.h"
+#include "dwi/tractography/index.h"
 #include "dwi/tractography/properties.h"
 
 #include "dwi/tractography/ACT/tissues.h"
@@ -324,12 +325,24 @@ namespace MR
         track_t tck_counter = 0;
         Tractography::Streamline<> tck;
         ProgressBar progress ("Writing filtered tracks output file", contributions.size());
-        while (reader (tck) && tck_counter < contributions.size()) {
-          if (contributions[tck_counter++])
-            writer (tck);
-          else
-            writer.skip();
-          ++progress;
+        // with an offset index, only the streamlines retained need to be read:
+        Tractography::Index index;
+        if (index.load (input_path)) {
+          for (; tck_counter < std::min (contributions.size(), index.size()); ++tck_counter) {
+            if (contributions[tck_counter] && reader.read (index, tck_counter, tck))
+              writer (tck);
+            else
+              writer.skip();
+            ++progress;
+          }
+        } else {
+          while (reader (tck) && tck_counter < contributions.size()) {
+            if (contributions[tck_counter++])
+              writer (tck);
+            else
+              writer.skip();
+            ++progress;
+          }
         }
         reader.close();
       }
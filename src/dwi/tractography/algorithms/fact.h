@@ -93,6 +93,7 @@ namespace MR
 
       bool init() override
       {
+        use_local_source (source);
         if (!get_data (source)) return false;
         if (!S.init_dir.allFinite()) {
           if (!dir.allFinite())
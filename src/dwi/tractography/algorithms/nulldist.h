@@ -57,6 +57,7 @@ namespace MR
 
 
       bool init() override {
+        use_local_source (source);
         if (!get_data (source))
           return false;
         dir = S.init_dir.allFinite() ? S.init_dir : random_direction();
@@ -113,6 +114,7 @@ namespace MR
         sample_idx (S.num_samples) { }
 
       bool init() override {
+        use_local_source (source);
         if (!get_data (source))
           return false;
         dir = S.init_dir.allFinite() ? S.init_dir : random_direction();
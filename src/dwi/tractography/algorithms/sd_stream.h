@@ -99,6 +99,7 @@ class SDStream : public MethodBase { MEMALIGN(SDStream)
 
     bool init() override
     {
+      use_local_source (source);
       if (!get_data (source))
         return (false);
 
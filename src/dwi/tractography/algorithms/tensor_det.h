@@ -98,6 +98,7 @@ namespace MR
 
       bool init() override
       {
+        use_local_source (source);
         if (!get_data (source))
           return false;
         return do_init();
@@ -25,6 +25,8 @@
 #include "file/key_value.h"
 #include "file/ofstream.h"
 #include "dwi/tractography/file_base.h"
+#include "dwi/tractography/index.h"
+#include "dwi/tractography/quantisation.h"
 #include "dwi/tractography/properties.h"
 #include "dwi/tractography/streamline.h"
 
@@ -64,15 +66,41 @@ namespace MR
 
 
       //! A class to read streamlines data
+      /*! The track data are read from file in large blocks, which are
+       * converted to \a ValueType (including any byte-swapping) in bulk.
+       * Each streamline is then located by scanning the block for the next
+       * delimiter, and copied out of the block in one go. The size of the
+       * block defaults to 4MB, and can be set in the config file using the
+       * TrackReaderBufferSize field (in bytes).
+       *
+       * Quantised track files (see WriterUnbuffered) are decoded block by
+       * block into the same representation, and can only be read
+       * sequentially. */
+      //CONF option: TrackReaderBufferSize
+      //CONF default: 4194304
+      //CONF The size of the buffer (in bytes) to use when reading track
+      //CONF files. MRtrix will read the track data in blocks of this size,
+      //CONF to limit the number of read() calls and allow the data to be
+      //CONF decoded in bulk.
       template <class ValueType = float>
       class Reader : public __ReaderBase__, public ReaderInterface<ValueType>
       { NOMEMALIGN
         public:
+          using point_type = Eigen::Matrix<ValueType,3,1>;
 
           //! open the \c file for reading and load header into \c properties
           Reader (const std::string& file, Properties& properties) :
-            current_index (0) {
+            current_index (0),
+            remaining (-1),
+            pos (0),
+            leftover (0) {
               open (file, "tracks", properties);
+              if (quantisation)
+                decoder = Quantisation::Decoder (quantisation);
+              // no need for a buffer larger than the data themselves:
+              const size_t point_size = 3 * dtype.bytes();
+              buffer_capacity = std::min (int64_t (File::Config::get_int ("TrackReaderBufferSize", 4194304)), data_size()) / point_size;
+              buffer_capacity = std::max (buffer_capacity, size_t (1));
               auto opt = App::get_options ("tck_weights_in");
               if (opt.size()) {
                 weights_file.reset (new std::ifstream (str(opt[0][0]).c_str(), std::ios_base::in));
@@ -84,49 +112,109 @@ namespace MR
 
             //! fetch next track from file
             bool operator() (Streamline<ValueType>& tck) {
-              tck.clear();
-
-              if (!in.is_open())
+              if (!next (tck))
                 return false;
 
-              do {
-                auto p = get_next_point();
-                if (std::isinf (p[0])) {
-                  in.close();
-                  check_excess_weights();
-                  return false;
-                }
-                if (in.eof()) {
-                  in.close();
-                  check_excess_weights();
+              if (weights_file) {
+
+                (*weights_file) >> tck.weight;
+                if (weights_file->fail()) {
+                  WARN ("Streamline weights file contains less entries than .tck file; only read " + str(current_index-1) + " streamlines");
+                  finish (false);
+                  tck.clear();
                   return false;
                 }
 
-                if (std::isnan (p[0])) {
-                  tck.index = current_index++;
+              } else {
+                tck.weight = 1.0;
+              }
 
-                  if (weights_file) {
+              return true;
+            }
 
-                    (*weights_file) >> tck.weight;
-                    if (weights_file->fail()) {
-                      WARN ("Streamline weights file contains less entries than .tck file; only read " + str(current_index-1) + " streamlines");
-                      in.close();
-                      tck.clear();
-                      return false;
-                    }
 
-                  } else {
-                    tck.weight = 1.0;
-                  }
+            //! read streamline \a n directly, using the offset \a index of the file
+            /*! Returns false if \a n is beyond the end of the index. This
+             * moves the read position, so sequential reading using
+             * operator() cannot be resumed afterwards. If a streamline
+             * weights file was provided, it is loaded in full on first use. */
+            bool read (const Index& index, const size_t n, Streamline<ValueType>& tck) {
+              tck.clear();
+              if (n >= index.size())
+                return false;
+              if (weights_file) {
+                float w;
+                weights_file->clear();
+                weights_file->seekg (0);
+                while ((*weights_file) >> w)
+                  weights.push_back (w);
+                weights_file.reset();
+              }
+              set_range (index.offset (n), index.offset (n+1), n);
+              if (!next (tck))
+                throw Exception ("error reading streamline " + str(n) + " from file \"" + name() + "\": offset index does not match track data");
+              if (weights.size()) {
+                if (n >= weights.size())
+                  throw Exception ("Streamline weights file contains less entries than .tck file; no weight for streamline " + str(n));
+                tck.weight = weights[n];
+              }
+              return true;
+            }
 
-                  return true;
-                }
 
-                tck.push_back (p);
-              } while (in.good());
+            //! only read the streamlines within a portion of the file
+            /*! Reading starts at byte offset \a first (which must be either
+             * the start of the track data, or immediately follow a
+             * delimiter), and stops at byte offset \a last; any streamline
+             * not terminated by then is discarded. Streamlines are numbered
+             * from \a first_index onwards. Streamline weights are not read
+             * in this mode, and must be handled by the caller. */
+            void set_range (int64_t first, int64_t last, uint64_t first_index) {
+              assert (first >= data_offset && last >= first);
+              if (quantisation)
+                throw Exception ("random access is not supported for quantised track file \"" + name() + "\"");
+              if (!in.is_open())
+                in.open (data_path.c_str(), std::ios::in | std::ios::binary);
+              in.clear();
+              in.seekg (first);
+              remaining = last - first;
+              current_index = first_index;
+              weights_file.reset();
+              points.clear();
+              pos = 0;
+            }
 
-              in.close();
-              return false;
+
+            //! locate the streamline delimiters within the range set using set_range()
+            /*! Returns the number of streamlines terminated within the range,
+             * without reading them. On return, \a first_delimiter holds the
+             * byte offset of the first delimiter (or -1 if there was none),
+             * and \a barrier that of the barrier marking the end of the data
+             * (or -1 if it was not reached). The file is closed once done. */
+            uint64_t scan (int64_t& first_delimiter, int64_t& barrier)
+            {
+              assert (!quantisation);
+              first_delimiter = barrier = -1;
+              uint64_t count = 0;
+              const size_t point_size = 3 * dtype.bytes();
+              int64_t offset = in.tellg();
+              while (load_block()) {
+                for (size_t n = 0; n < points.size(); ++n) {
+                  if (std::isfinite (points[n][0]))
+                    continue;
+                  if (std::isinf (points[n][0])) {
+                    barrier = offset + n * point_size;
+                    finish (false);
+                    return count;
+                  }
+                  if (first_delimiter < 0)
+                    first_delimiter = offset + n * point_size;
+                  ++count;
+                }
+                offset += points.size() * point_size;
+              }
+              finish (false);
+              return count;
             }
 
 
@@ -134,47 +222,139 @@ namespace MR
         protected:
           using __ReaderBase__::in;
           using __ReaderBase__::dtype;
+          using __ReaderBase__::data_offset;
+          using __ReaderBase__::data_path;
+          using __ReaderBase__::quantisation;
 
           uint64_t current_index;
           std::unique_ptr<std::ifstream> weights_file;
 
-          //! takes care of byte ordering issues
+          int64_t remaining;
+          size_t buffer_capacity, pos;
+          vector<point_type> points;
+          std::unique_ptr<char[]> raw;
+          vector<float> weights;
+          Quantisation::Decoder decoder;
+          size_t leftover;
+
+          //! fetch the points of the next track, up to its delimiter
+          bool next (Streamline<ValueType>& tck)
+          {
+            tck.clear();
+
+            if (!in.is_open())
+              return false;
+
+            while (true) {
+              if (pos == points.size() && !load_block()) {
+                finish();
+                return false;
+              }
+
+              // copy all points up to the next delimiter (or the end of
+              // the block) in one go:
+              size_t end = pos;
+              while (end < points.size() && std::isfinite (points[end][0]))
+                ++end;
+              tck.insert (tck.end(), points.begin() + pos, points.begin() + end);
+              pos = end;
+              if (pos == points.size())
+                continue;
+
+              if (std::isinf (points[pos++][0])) {
+                finish();
+                return false;
+              }
+
+              tck.index = current_index++;
+              return true;
+            }
+          }
+
+          //! read the next block of points from file, and convert to ValueType
+          /*! Any incomplete point at the end of the file is discarded.
+           * Returns false if no further points could be read. */
+          bool load_block ()
+          {
+            points.clear();
+            pos = 0;
+            if (!in.is_open() || !in.good())
+              return false;
+
+            const size_t point_size = 3 * dtype.bytes();
+            if (!raw)
+              raw.reset (new char [buffer_capacity * point_size]);
+            if (quantisation)
+              return load_quantised_block (buffer_capacity * point_size);
+
+            int64_t bytes = buffer_capacity * point_size;
+            if (remaining >= 0)
+              bytes = std::min (bytes, remaining);
+            in.read (raw.get(), bytes);
+            const size_t num = in.gcount() / point_size;
+            if (!num)
+              return false;
+            if (remaining >= 0)
+              remaining -= num * point_size;
+
+            points.resize (num);
+            switch (dtype()) {
+              case DataType::Float32LE: decode<float> (num, true); break;
+              case DataType::Float32BE: decode<float> (num, false); break;
+              case DataType::Float64LE: decode<double> (num, true); break;
+              case DataType::Float64BE: decode<double> (num, false); break;
+              default:
+                assert (0);
+                break;
+            }
+            return true;
+          }
+
+          //! read & decode the next block of data from a quantised file
+          /*! Any value left incomplete at the end of the block is carried
+           * over to the start of the next. */
+          bool load_quantised_block (const size_t capacity)
+          {
+            do {
+              in.read (raw.get() + leftover, capacity - leftover);
+              if (!in.gcount())
+                return false;
+              const char* end = raw.get() + leftover + in.gcount();
+              const char* consumed = decoder (raw.get(), end, points);
+              leftover = end - consumed;
+              std::memmove (raw.get(), consumed, leftover);
+            } while (points.empty());
+            return true;
+          }
 
-            Eigen::Matrix<ValueType,3,1> get_next_point ()
+          //! takes care of byte ordering issues
+          template <typename RawType>
+            void decode (size_t num, bool little_endian)
             {
               using namespace ByteOrder;
-              switch (dtype()) {
-                case DataType::Float32LE:
-                  {
-                    float p[3];
-                    in.read ((char*) p, sizeof (p));
-                    return { ValueType(LE(p[0])), ValueType(LE(p[1])), ValueType(LE(p[2])) };
-                  }
-                case DataType::Float32BE:
-                  {
-                    float p[3];
-                    in.read ((char*) p, sizeof (p));
-                    return { ValueType(BE(p[0])), ValueType(BE(p[1])), ValueType(BE(p[2])) };
-                  }
-                case DataType::Float64LE:
-                  {
-                    double p[3];
-                    in.read ((char*) p, sizeof (p));
-                    return { ValueType(LE(p[0])), ValueType(LE(p[1])), ValueType(LE(p[2])) };
-                  }
-                case DataType::Float64BE:
-                  {
-                    double p[3];
-                    in.read ((char*) p, sizeof (p));
-                    return { ValueType(BE(p[0])), ValueType(BE(p[1])), ValueType(BE(p[2])) };
-                  }
-                default:
-                  assert (0);
-                  break;
+              const RawType* p = reinterpret_cast<const RawType*> (raw.get());
+              if (little_endian) {
+                for (size_t n = 0; n < num; ++n, p += 3)
+                  points[n] = { ValueType(LE(p[0])), ValueType(LE(p[1])), ValueType(LE(p[2])) };
+              }
+              else {
+                for (size_t n = 0; n < num; ++n, p += 3)
+                  points[n] = { ValueType(BE(p[0])), ValueType(BE(p[1])), ValueType(BE(p[2])) };
               }
-              return { NaN, NaN, NaN };
             }
 
+          //! close the file and release the buffers once all tracks are read
+          void finish (bool check_weights = true)
+          {
+            in.close();
+            points.clear();
+            points.shrink_to_fit();
+            raw.reset();
+            pos = 0;
+            if (check_weights)
+              check_excess_weights();
+          }
+
           //! Check that the weights file does not contain excess entries
           void check_excess_weights()
           {
@@ -201,6 +381,11 @@ namespace MR
        * tracks to the file specified in \a file. Writing individual tracks is
        * done using the operator() method.
        *
+       * If the TrackQuantisation config file option is set, the tracks are
+       * instead written in a compact quantised format (see Quantisation),
+       * with vertex positions rounded such that each lies within the
+       * specified distance (in mm) of its true position.
+       *
        * This class re-opens the output file every time a new streamline is
        * written. This may result in slow operation in some circumstances, and
        * may lead to fragmentation on some file systems, but is necessary in
@@ -208,6 +393,15 @@ namespace MR
        * at once. For most applications (where typically one track file is
        * written at a time), the Writer class is more appropriate.
        * */
+      //CONF option: TrackQuantisation
+      //CONF default: 0
+      //CONF If set to a non-zero value, track files are written in a
+      //CONF compact quantised format, with vertex positions rounded such
+      //CONF that each lies within this distance (in mm) of its true
+      //CONF position; e.g. 0.01 typically reduces the size of the file
+      //CONF 4-fold. Such files cannot be read by previous versions of
+      //CONF MRtrix3, and do not support random access or parallel
+      //CONF reading (see TrackLoaderThreads).
       template <class ValueType = float>
         class WriterUnbuffered : public __WriterBase__<ValueType>, public WriterInterface<ValueType>
       { NOMEMALIGN
@@ -220,6 +414,7 @@ namespace MR
           using __WriterBase__<ValueType>::verify_stream;
           using __WriterBase__<ValueType>::update_counts;
           using __WriterBase__<ValueType>::open_success;
+          using __WriterBase__<ValueType>::quantisation;
 
           using vector_type = Eigen::Matrix<ValueType,3,1>;
 
@@ -230,6 +425,13 @@ namespace MR
             if (!Path::has_suffix (name, ".tck"))
               throw Exception ("output track files must use the .tck suffix");
 
+            const float max_error = File::Config::get_float ("TrackQuantisation", 0.0f);
+            if (max_error < 0.0f)
+              throw Exception ("TrackQuantisation config file option must not be negative");
+            // use the step exactly as stored in the header:
+            if (max_error)
+              quantisation = to<double> (str (Quantisation::step_for_error (max_error), 10));
+
             File::OFStream out;
             try {
               out.open (name, std::ios::out | std::ios::binary | std::ios::trunc);
@@ -243,9 +445,13 @@ namespace MR
             create (out, properties, "tracks");
             barrier_addr = out.tellp();
 
-            vector_type x;
-            format_point (barrier(), x);
-            out.write (reinterpret_cast<char*> (&x[0]), sizeof (x));
+            if (quantisation) {
+              out.put ('\0');
+            } else {
+              vector_type x;
+              format_point (barrier(), x);
+              out.write (reinterpret_cast<char*> (&x[0]), sizeof (x));
+            }
             if (!out.good())
               throw Exception ("error writing tracks file \"" + name + "\": " + strerror (errno));
             open_success = true;
@@ -257,15 +463,22 @@ namespace MR
 
           //! append track to file
           bool operator() (const Streamline<ValueType>& tck) {
-            // allocate buffer on the stack for performance:
-            NON_POD_VLA (buffer, vector_type, tck.size()+2);
-            for (size_t n = 0; n < tck.size(); ++n) {
-              assert (tck[n].allFinite());
-              format_point (tck[n], buffer[n]);
+            if (quantisation) {
+              std::string data;
+              Quantisation::encode (tck, quantisation, data);
+              commit (data);
             }
-            format_point (delimiter(), buffer[tck.size()]);
+            else {
+              // allocate buffer on the stack for performance:
+              NON_POD_VLA (buffer, vector_type, tck.size()+2);
+              for (size_t n = 0; n < tck.size(); ++n) {
+                assert (tck[n].allFinite());
+                format_point (tck[n], buffer[n]);
+              }
+              format_point (delimiter(), buffer[tck.size()]);
 
-            commit (buffer, tck.size()+1);
+              commit (buffer, tck.size()+1);
+            }
 
             if (weights_name.size())
               write_weights (str(tck.weight) + "\n");
@@ -332,6 +545,26 @@ namespace MR
             update_counts (out);
           }
 
+          //! write encoded track data to a quantised file
+          /*! As above, the new terminator is written before the previous one
+           * is overwritten, so the file remains valid throughout. */
+          void commit (const std::string& data) {
+            if (data.empty() || !open_success)
+              return;
+
+            int64_t prev_barrier_addr = barrier_addr;
+
+            File::OFStream out (name, std::ios::in | std::ios::out | std::ios::binary | std::ios::ate);
+            out.write (data.data()+1, data.size()-1);
+            out.put ('\0');
+            verify_stream (out);
+            barrier_addr = int64_t (out.tellp()) - 1;
+            out.seekp (prev_barrier_addr, out.beg);
+            out.put (data[0]);
+            verify_stream (out);
+            update_counts (out);
+          }
+
 
           //! copy construction explicitly disabled
           WriterUnbuffered (const WriterUnbuffered&) = delete;
@@ -365,6 +598,7 @@ namespace MR
           using WriterUnbuffered<ValueType>::format_point;
           using WriterUnbuffered<ValueType>::weights_name;
           using WriterUnbuffered<ValueType>::write_weights;
+          using WriterUnbuffered<ValueType>::quantisation;
           using vector_type = typename WriterUnbuffered<ValueType>::vector_type;
 
           //! create new RAM-buffered track file with specified properties
@@ -381,7 +615,7 @@ namespace MR
           Writer (const std::string& file, const Properties& properties, size_t default_buffer_capacity = 16777216) :
             WriterUnbuffered<ValueType> (file, properties),
             buffer_capacity (File::Config::get_int ("TrackWriterBufferSize", default_buffer_capacity) / sizeof (vector_type)),
-            buffer (new vector_type [buffer_capacity]),
+            buffer (quantisation ? nullptr : new vector_type [buffer_capacity]),
             buffer_size (0) { }
 
           Writer (const Writer& W) = delete;
@@ -393,14 +627,21 @@ namespace MR
 
           //! append track to file
           bool operator() (const Streamline<ValueType>& tck) {
-            if (buffer_size + tck.size() + 2 > buffer_capacity)
-              commit ();
+            if (quantisation) {
+              Quantisation::encode (tck, quantisation, encoded);
+              if (encoded.size() >= buffer_capacity * sizeof (vector_type))
+                commit ();
+            }
+            else {
+              if (buffer_size + tck.size() + 2 > buffer_capacity)
+                commit ();
 
-            for (const auto& i : tck) {
-              assert (i.allFinite());
-              add_point (i);
+              for (const auto& i : tck) {
+                assert (i.allFinite());
+                add_point (i);
+              }
+              add_point (delimiter());
             }
-            add_point (delimiter());
 
             if (weights_name.size())
               weights_buffer += str (tck.weight) + ' ';
@@ -415,7 +656,7 @@ namespace MR
           const size_t buffer_capacity;
           std::unique_ptr<vector_type[]> buffer;
           size_t buffer_size;
-          std::string weights_buffer;
+          std::string encoded, weights_buffer;
 
           //! add point to buffer and increment buffer_size accordingly
           void add_point (const vector_type& p) {
@@ -423,8 +664,14 @@ namespace MR
           }
 
           void commit () {
-            WriterUnbuffered<ValueType>::commit (buffer.get(), buffer_size);
-            buffer_size = 0;
+            if (quantisation) {
+              WriterUnbuffered<ValueType>::commit (encoded);
+              encoded.clear();
+            }
+            else {
+              WriterUnbuffered<ValueType>::commit (buffer.get(), buffer_size);
+              buffer_size = 0;
+            }
 
             if (weights_name.size()) {
               write_weights (weights_buffer);
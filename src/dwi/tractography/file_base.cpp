@@ -25,6 +25,7 @@ namespace MR {
       {
         properties.clear();
         dtype = DataType::Undefined;
+        quantisation = 0.0;
 
         const std::string firstline ("mrtrix " + type);
         File::KeyValue kv (file, firstline.c_str());
@@ -44,9 +45,18 @@ namespace MR {
           else if (key == "comment") properties.comments.push_back (kv.value());
           else if (key == "file") data_file = kv.value();
           else if (key == "datatype") dtype = DataType::parse (kv.value());
+          else if (key == "quantisation") quantisation = to<double> (kv.value());
           else properties[kv.key()] = kv.value();
         }
 
+        if (quantisation) {
+          // quantised data are decoded to native floating-point:
+          if (!std::isfinite (quantisation) || quantisation <= 0.0)
+            throw Exception ("invalid quantisation step specified for " + type  + " file \"" + file + "\"");
+          dtype = DataType::Float32;
+          dtype.set_byte_order_native();
+        }
+
         if (dtype == DataType::Undefined)
           throw Exception ("no datatype specified for tracks file \"" + file + "\"");
         if (dtype != DataType::Float32LE && dtype != DataType::Float32BE &&
@@ -77,7 +87,12 @@ namespace MR {
         in.open (fname.c_str(), std::ios::in | std::ios::binary);
         if (!in)
           throw Exception ("error opening " + type  + " data file \"" + fname + "\": " + strerror(errno));
+        in.seekg (0, in.end);
+        data_bytes = std::max (int64_t (in.tellg()) - offset, int64_t (0));
         in.seekg (offset);
+        filename = file;
+        data_path = fname;
+        data_offset = offset;
       }
 
     }
@@ -48,10 +48,24 @@ namespace MR
 
           void close () { in.close(); }
 
+          //! the name of the file opened
+          const std::string& name () const { return filename; }
+          //! the byte offset to the start of the data within the data file
+          int64_t data_start () const { return data_offset; }
+          //! the number of bytes from the start of the data to the end of the data file
+          int64_t data_size () const { return data_bytes; }
+          //! the type of the data stored in the file
+          DataType datatype () const { return dtype; }
+          //! the quantisation step of the data, or zero if they are stored as floating-point
+          double quantisation_step () const { return quantisation; }
+
         protected:
 
           std::ifstream  in;
           DataType  dtype;
+          std::string filename, data_path;
+          int64_t data_offset, data_bytes;
+          double quantisation;
       };
 
 
@@ -66,6 +80,7 @@ namespace MR
               total_count (0),
               name (name),
               dtype (DataType::from<ValueType>()),
+              quantisation (0.0),
               count_offset (0),
               open_success (false)
           {
@@ -108,7 +123,10 @@ namespace MR
               for (const auto& it : properties.roi)
                 out << "roi: " << it.first << " " << it.second << "\n";
 
-              out << "datatype: " << dtype.specifier() << "\n";
+              if (quantisation)
+                out << "quantisation: " << str(quantisation, 10) << "\n";
+              else
+                out << "datatype: " << dtype.specifier() << "\n";
               int64_t data_offset = int64_t(out.tellp()) + 65;
               data_offset += (4 - (data_offset % 4)) % 4;
               out << "file: . " << data_offset << "\n";
@@ -130,6 +148,7 @@ namespace MR
           protected:
             std::string name;
             DataType dtype;
+            double quantisation;
             int64_t count_offset;
             bool open_success;
 
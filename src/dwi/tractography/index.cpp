@@ -0,0 +1,153 @@
+/*
+ * Copyright (c) 2008-2018 the MRtrix3 contributors.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at http://mozilla.org/MPL/2.0/
+ *
+ * MRtrix3 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * For more details, see http://www.mrtrix.org/
+ */
+
+
+#include "dwi/tractography/index.h"
+
+#include "progressbar.h"
+#include "raw.h"
+#include "file/key_value.h"
+#include "file/ofstream.h"
+#include "file/path.h"
+#include "dwi/tractography/file.h"
+
+
+namespace MR
+{
+  namespace DWI
+  {
+    namespace Tractography
+    {
+
+
+      namespace {
+        const char* const index_firstline = "mrtrix track index";
+      }
+
+
+
+      void Index::get_key (const std::string& tck_file)
+      {
+        Properties properties;
+        __ReaderBase__ reader;
+        reader.open (tck_file, "tracks", properties);
+        auto stamp = properties.find ("timestamp");
+        timestamp = stamp == properties.end() ? std::string() : stamp->second;
+        data_size = reader.data_size();
+        point_size = 3 * reader.datatype().bytes();
+      }
+
+
+
+      bool Index::load (const std::string& tck_file)
+      {
+        offsets.clear();
+        const std::string index_file = path (tck_file);
+        if (!Path::exists (index_file))
+          return false;
+
+        get_key (tck_file);
+        try {
+          File::KeyValue kv (index_file, index_firstline);
+          std::string stamp, data_file;
+          int64_t size = -1;
+          size_t count = 0;
+          while (kv.next()) {
+            const std::string key = lowercase (kv.key());
+            if (key == "timestamp") stamp = kv.value();
+            else if (key == "data_size") size = to<int64_t> (kv.value());
+            else if (key == "count") count = to<size_t> (kv.value());
+            else if (key == "file") data_file = kv.value();
+            else if (key == "datatype" && DataType::parse (kv.value()) != DataType::UInt64LE)
+              throw Exception ("unsupported datatype");
+          }
+          if (stamp != timestamp || size != data_size) {
+            INFO ("ignoring out-of-date offset index \"" + index_file + "\"");
+            return false;
+          }
+
+          const auto files = split (data_file, " \t", true);
+          if (files.size() != 2 || files[0] != ".")
+            throw Exception ("invalid file specification");
+          std::ifstream in (index_file, std::ios::in | std::ios::binary);
+          in.seekg (to<int64_t> (files[1]));
+          vector<uint64_t> raw (count+1);
+          in.read (reinterpret_cast<char*> (raw.data()), raw.size() * sizeof (uint64_t));
+          if (!in)
+            throw Exception ("file is truncated");
+
+          offsets.reserve (raw.size());
+          for (const auto offset : raw)
+            offsets.push_back (ByteOrder::LE (offset));
+        }
+        catch (Exception& e) {
+          offsets.clear();
+          WARN ("error reading offset index \"" + index_file + "\" (" + e[0] + ") - ignored");
+          return false;
+        }
+        DEBUG ("loaded offset index for " + str(size()) + " streamlines from \"" + index_file + "\"");
+        return true;
+      }
+
+
+
+      void Index::build (const std::string& tck_file)
+      {
+        get_key (tck_file);
+        Properties properties;
+        Reader<> reader (tck_file, properties);
+        if (reader.quantisation_step())
+          throw Exception ("cannot index quantised track file \"" + tck_file + "\": these can only be read sequentially");
+        offsets.clear();
+        int64_t offset = reader.data_start();
+        Streamline<> tck;
+        ProgressBar progress ("indexing streamlines in file \"" + Path::basename (tck_file) + "\"");
+        while (reader (tck)) {
+          offsets.push_back (offset);
+          offset += (tck.size() + 1) * point_size;
+          ++progress;
+        }
+        offsets.push_back (offset);
+      }
+
+
+
+      void Index::save (const std::string& tck_file) const
+      {
+        std::string header = std::string (index_firstline) + "\n"
+          "timestamp: " + timestamp + "\n"
+          "data_size: " + str(data_size) + "\n"
+          "datatype: " + DataType (DataType::UInt64LE).specifier() + "\n"
+          "count: " + str(size()) + "\n";
+        int64_t data_offset = header.size() + 40;
+        data_offset += (8 - (data_offset % 8)) % 8;
+        header += "file: . " + str(data_offset) + "\nEND\n";
+
+        File::OFStream out (path (tck_file), std::ios::out | std::ios::binary | std::ios::trunc);
+        out << header;
+        out << std::string (data_offset - header.size(), '\0');
+        vector<uint64_t> raw;
+        raw.reserve (offsets.size());
+        for (const auto offset : offsets)
+          raw.push_back (ByteOrder::LE (uint64_t (offset)));
+        out.write (reinterpret_cast<const char*> (raw.data()), raw.size() * sizeof (uint64_t));
+        if (!out.good())
+          throw Exception ("error writing offset index \"" + path (tck_file) + "\": " + strerror (errno));
+      }
+
+
+    }
+  }
+}
+
@@ -0,0 +1,91 @@
+/*
+ * Copyright (c) 2008-2018 the MRtrix3 contributors.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at http://mozilla.org/MPL/2.0/
+ *
+ * MRtrix3 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * For more details, see http://www.mrtrix.org/
+ */
+
+
+#ifndef __dwi_tractography_index_h__
+#define __dwi_tractography_index_h__
+
+#include "types.h"
+
+
+namespace MR
+{
+  namespace DWI
+  {
+    namespace Tractography
+    {
+
+
+      //! The offset index of a track file
+      /*! Track files can otherwise only be read sequentially, since the
+       * location of each streamline depends on the lengths of all those
+       * preceding it. The index holds the byte offset of every streamline
+       * within the track data, so that any streamline can be read directly
+       * (see Reader::read()), and the file split exactly between threads.
+       *
+       * The index is stored in a sidecar file alongside the track file, with
+       * the suffix ".idx" appended (e.g. "tracks.tck.idx"), and can be
+       * generated using 'tckinfo -index'. It consists of a short text header
+       * (in the same format as the track file itself), followed by the
+       * offsets as 64-bit little-endian unsigned integers: one per
+       * streamline, plus the offset of the end of the data. The header
+       * records the timestamp and data size of the track file, so that an
+       * index that no longer matches its track file is ignored. */
+      class Index
+      { NOMEMALIGN
+        public:
+          Index () : point_size (0) { }
+
+          //! load the index from the sidecar file of \a tck_file
+          /*! Returns false if there is no sidecar file, or if it does not
+           * match the current contents of the track file; the index is then
+           * left empty. */
+          bool load (const std::string& tck_file);
+
+          //! build the index by reading through the whole of \a tck_file
+          void build (const std::string& tck_file);
+
+          //! write the index to the sidecar file of \a tck_file
+          void save (const std::string& tck_file) const;
+
+          //! the number of streamlines indexed
+          size_t size () const { return offsets.size() ? offsets.size() - 1 : 0; }
+          bool empty () const { return !size(); }
+
+          //! the byte offset of streamline \a n within the data file
+          /*! For \a n equal to size(), this is the offset of the end of the
+           * streamline data. */
+          int64_t offset (size_t n) const { assert (n < offsets.size()); return offsets[n]; }
+          //! the number of points in streamline \a n
+          size_t num_points (size_t n) const { return (offset (n+1) - offset (n)) / point_size - 1; }
+
+          //! the path of the sidecar file for \a tck_file
+          static std::string path (const std::string& tck_file) { return tck_file + ".idx"; }
+
+        private:
+          vector<int64_t> offsets;
+          int64_t point_size;
+          std::string timestamp;
+          int64_t data_size;
+
+          void get_key (const std::string& tck_file);
+      };
+
+
+    }
+  }
+}
+
+#endif
+
@@ -0,0 +1,300 @@
+/*
+ * Copyright (c) 2008-2018 the MRtrix3 contributors.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at http://mozilla.org/MPL/2.0/
+ *
+ * MRtrix3 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * For more details, see http://www.mrtrix.org/
+ */
+
+
+#include "dwi/tractography/mapping/loader.h"
+
+#include <atomic>
+#include <limits>
+#include <mutex>
+
+#include "app.h"
+#include "thread.h"
+#include "file/config.h"
+#include "dwi/tractography/index.h"
+
+
+namespace MR {
+  namespace DWI {
+    namespace Tractography {
+      namespace Mapping {
+
+
+
+        namespace {
+
+          // don't bother splitting the file into chunks smaller than this:
+          constexpr int64_t min_chunk_size = 1<<20;
+          // more chunks than threads, so that the load remains balanced:
+          constexpr size_t chunks_per_thread = 4;
+
+
+
+          class ChunkScanner { NOMEMALIGN
+            public:
+              struct Result { NOMEMALIGN
+                int64_t first_delimiter, barrier;
+                uint64_t count;
+              };
+
+              ChunkScanner (const std::string& path, const vector<int64_t>& bounds, vector<Result>& results, std::atomic<size_t>& next) :
+                path (path),
+                bounds (bounds),
+                results (results),
+                next (next) { }
+
+              void execute () {
+                size_t c;
+                while ((c = next++) < results.size()) {
+                  Properties properties;
+                  Reader<> in (path, properties);
+                  in.set_range (bounds[c], bounds[c+1], 0);
+                  results[c].count = in.scan (results[c].first_delimiter, results[c].barrier);
+                }
+              }
+
+            private:
+              const std::string& path;
+              const vector<int64_t>& bounds;
+              vector<Result>& results;
+              std::atomic<size_t>& next;
+          };
+
+        }
+
+
+
+
+        class TrackLoader::Shared { NOMEMALIGN
+          public:
+            Shared (const size_t to_load, const std::string& msg);
+
+            struct Chunk { NOMEMALIGN
+              int64_t first, last;
+              uint64_t first_index;
+            };
+
+            std::mutex mutex;
+            std::unique_ptr<ProgressBar> progress;
+            size_t nthreads;
+            uint64_t index_limit;
+            vector<Chunk> chunks;
+            std::atomic<size_t> next, done;
+            vector<float> weights;
+            bool split_checked;
+
+            void split (Reader<>& reader, const size_t requested_threads);
+
+          private:
+            uint64_t scan (Reader<>& reader, const size_t num_chunks, const size_t num_threads);
+            void load_weights (const uint64_t num_tracks);
+        };
+
+
+
+        TrackLoader::Shared::Shared (const size_t to_load, const std::string& msg) :
+            progress (msg.size() ? new ProgressBar (msg, to_load) : nullptr),
+            nthreads (1),
+            index_limit (to_load ? to_load : std::numeric_limits<uint64_t>::max()),
+            next (0),
+            done (0),
+            split_checked (false) { }
+
+
+
+        void TrackLoader::Shared::split (Reader<>& reader, const size_t requested_threads)
+        {
+          // quantised files can only be read sequentially:
+          if (reader.quantisation_step())
+            return;
+          const size_t num_chunks = std::min (requested_threads * chunks_per_thread, size_t (reader.data_size() / min_chunk_size));
+          if (num_chunks < 2)
+            return;
+
+          // with an up-to-date offset index, the file can be split exactly
+          // between streamlines without having to scan it:
+          Index index;
+          uint64_t num_tracks = 0;
+          if (index.load (reader.name())) {
+            num_tracks = index.size();
+            for (size_t c = 0; c < num_chunks; ++c) {
+              const size_t first = (num_tracks * c) / num_chunks, last = (num_tracks * (c+1)) / num_chunks;
+              chunks.push_back ({ index.offset (first), index.offset (last), first });
+            }
+          }
+          else
+            num_tracks = scan (reader, num_chunks, requested_threads);
+
+          load_weights (num_tracks);
+          nthreads = requested_threads;
+          DEBUG ("reading " + str(num_tracks) + " streamlines from file \"" + reader.name() + "\" in " + str(chunks.size()) + " chunks using " + str(nthreads) + " threads");
+        }
+
+
+
+        uint64_t TrackLoader::Shared::scan (Reader<>& reader, const size_t num_chunks, const size_t num_threads)
+        {
+          const int64_t point_size = 3 * reader.datatype().bytes();
+          const int64_t num_points = reader.data_size() / point_size;
+
+          // initial chunk boundaries, at arbitrary points within the data:
+          vector<int64_t> bounds;
+          for (size_t c = 0; c <= num_chunks; ++c)
+            bounds.push_back (reader.data_start() + ((num_points * int64_t(c)) / int64_t(num_chunks)) * point_size);
+
+          // locate the delimiters within each chunk in parallel:
+          vector<ChunkScanner::Result> results (num_chunks);
+          {
+            std::atomic<size_t> next_scan (0);
+            ChunkScanner scanner (reader.name(), bounds, results, next_scan);
+            Thread::run (Thread::multi (scanner, std::min (num_threads, num_chunks)), "track file scan threads").wait();
+          }
+
+          // move each boundary to just after the first delimiter in the
+          // corresponding chunk, and number the streamlines from there:
+          int64_t first = bounds[0], last = bounds[num_chunks];
+          uint64_t first_index = 0, num_tracks = 0;
+          for (size_t c = 0; c < num_chunks; ++c) {
+            const auto& result (results[c]);
+            if (c && result.first_delimiter >= 0) {
+              const int64_t boundary = result.first_delimiter + point_size;
+              chunks.push_back ({ first, boundary, first_index });
+              first = boundary;
+              first_index = num_tracks + 1;
+            }
+            num_tracks += result.count;
+            if (result.barrier >= 0) {
+              last = result.barrier;
+              break;
+            }
+          }
+          chunks.push_back ({ first, last, first_index });
+          return num_tracks;
+        }
+
+
+
+        void TrackLoader::Shared::load_weights (const uint64_t num_tracks)
+        {
+          auto opt = App::get_options ("tck_weights_in");
+          if (!opt.size())
+            return;
+          std::ifstream in (str(opt[0][0]).c_str(), std::ios_base::in);
+          if (!in.good())
+            throw Exception ("Unable to open streamlines weights file " + str(opt[0][0]));
+          float weight;
+          while (weights.size() < num_tracks && in >> weight)
+            weights.push_back (weight);
+          if (weights.size() < num_tracks) {
+            WARN ("Streamline weights file contains less entries than .tck file; only read " + str(weights.size()) + " streamlines");
+            index_limit = std::min (index_limit, uint64_t (weights.size()));
+          }
+          else if (in >> weight)
+            WARN ("Streamline weights file contains more entries than .tck file");
+        }
+
+
+
+
+        TrackLoader::TrackLoader (Reader<>& file, const size_t to_load, const std::string& msg) :
+            reader (file),
+            tracks_to_load (to_load),
+            shared (new Shared (to_load, msg)) { }
+
+
+
+        size_t TrackLoader::num_threads () const
+        {
+          // only split the file once the loader is known to be run
+          // concurrently, since this requires scanning through it:
+          std::lock_guard<std::mutex> lock (shared->mutex);
+          if (!shared->split_checked) {
+            shared->split_checked = true;
+            const size_t requested_threads = File::Config::get_int ("TrackLoaderThreads", 1);
+            if (requested_threads > 1 && Thread::number_of_threads())
+              shared->split (reader, requested_threads);
+          }
+          return shared->nthreads;
+        }
+
+
+
+        bool TrackLoader::operator() (Streamline<>& out)
+        {
+          if (shared->nthreads == 1) {
+            if (!reader (out) || out.index >= shared->index_limit) {
+              out.clear();
+              std::lock_guard<std::mutex> lock (shared->mutex);
+              shared->progress.reset();
+              return false;
+            }
+          }
+          else {
+            while (true) {
+              if (!chunk && !next_chunk()) {
+                out.clear();
+                return false;
+              }
+              if ((*chunk) (out) && out.index < shared->index_limit)
+                break;
+              out.clear();
+              chunk_done();
+            }
+            if (shared->weights.size())
+              out.weight = shared->weights[out.index];
+          }
+
+          std::lock_guard<std::mutex> lock (shared->mutex);
+          if (shared->progress)
+            ++(*shared->progress);
+          return true;
+        }
+
+
+
+        bool TrackLoader::next_chunk ()
+        {
+          size_t c;
+          while ((c = shared->next++) < shared->chunks.size()) {
+            const auto& range (shared->chunks[c]);
+            if (range.first_index < shared->index_limit) {
+              Properties properties;
+              chunk.reset (new Reader<> (reader.name(), properties));
+              chunk->set_range (range.first, range.last, range.first_index);
+              return true;
+            }
+            chunk_done();
+          }
+          return false;
+        }
+
+
+
+        void TrackLoader::chunk_done ()
+        {
+          chunk.reset();
+          if (++shared->done == shared->chunks.size()) {
+            std::lock_guard<std::mutex> lock (shared->mutex);
+            shared->progress.reset();
+          }
+        }
+
+
+
+      }
+    }
+  }
+}
+
+
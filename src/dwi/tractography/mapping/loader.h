@@ -31,37 +31,57 @@ namespace MR {
 
 
 
+        //! Feeds the streamlines from a track file into a Thread::run_queue()
+        /*! By default, streamlines are read sequentially from the Reader
+         * provided. If the TrackLoaderThreads config file option is set to a
+         * value greater than one (and multi-threading is enabled), the track
+         * data are instead split into chunks at streamline boundaries,
+         * located using a quick parallel scan of the file (or taken directly
+         * from its offset index, if available; see Index); these chunks are
+         * then read concurrently, each through its own file handle, by that
+         * many copies of the loader. To allow for this, the loader should be
+         * passed to the queue as:
+         * \code
+         * Thread::run_queue (Thread::multi (loader, loader.num_threads()), ...);
+         * \endcode
+         * Streamlines are then no longer delivered in file order, but retain
+         * their index and weight. The file is only split on the first call
+         * to num_threads(), and is otherwise read sequentially. */
+        //CONF option: TrackLoaderThreads
+        //CONF default: 1
+        //CONF The number of threads to use when reading streamlines from
+        //CONF file for mapping (e.g. in tckmap, tck2connectome, tcksift &
+        //CONF tcksift2). Values greater than one allow large track files to
+        //CONF be split into chunks that are read in parallel, which can
+        //CONF help on fast storage if reading the file limits performance.
         class TrackLoader
         { MEMALIGN(TrackLoader)
 
           public:
-            TrackLoader (Reader<>& file, const size_t to_load = 0, const std::string& msg = "mapping tracks to image") :
-              reader (file),
-              tracks_to_load (to_load),
-              progress (msg.size() ? new ProgressBar (msg, tracks_to_load) : nullptr) { }
+            TrackLoader (Reader<>& file, const size_t to_load = 0, const std::string& msg = "mapping tracks to image");
+            TrackLoader (const TrackLoader& that) :
+              reader (that.reader),
+              tracks_to_load (that.tracks_to_load),
+              shared (that.shared) { }
 
             virtual ~TrackLoader() { }
-            virtual bool operator() (Streamline<>& out)
-            {
-              if (!reader (out)) {
-                progress.reset();
-                return false;
-              }
-              if (tracks_to_load && out.index >= tracks_to_load) {
-                out.clear();
-                progress.reset();
-                return false;
-              }
-              if (progress)
-                ++(*progress);
-              return true;
-            }
+            virtual bool operator() (Streamline<>& out);
+
+            //! the number of copies of this loader that can be run concurrently
+            /*! This must be invoked before any streamlines are loaded. */
+            size_t num_threads () const;
 
           protected:
             Reader<>& reader;
             const size_t tracks_to_load;
-            std::unique_ptr<ProgressBar> progress;
 
+          private:
+            class Shared;
+            std::shared_ptr<Shared> shared;
+            std::unique_ptr<Reader<>> chunk;
+
+            bool next_chunk ();
+            void chunk_done ();
         };
 
 
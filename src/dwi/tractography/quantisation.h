@@ -0,0 +1,160 @@
+/*
+ * Copyright (c) 2008-2018 the MRtrix3 contributors.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at http://mozilla.org/MPL/2.0/
+ *
+ * MRtrix3 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * For more details, see http://www.mrtrix.org/
+ */
+
+
+#ifndef __dwi_tractography_quantisation_h__
+#define __dwi_tractography_quantisation_h__
+
+#include <cmath>
+
+#include "types.h"
+#include "dwi/tractography/streamline.h"
+
+
+namespace MR
+{
+  namespace DWI
+  {
+    namespace Tractography
+    {
+
+
+      //! Encoding of streamlines in quantised track files
+      /*! In these files, vertex positions are stored as integer multiples of
+       * the quantisation step (given in the header), each coordinate being
+       * encoded as the difference from that of the previous vertex (or from
+       * zero for the first vertex), as a zig-zag variable-length integer
+       * (using 7 bits per byte). Each streamline is preceded by its number of
+       * vertices plus one, also as a variable-length integer, and the data
+       * are terminated by a zero. Since consecutive vertices are close
+       * together, most coordinates then require a single byte, rather than
+       * the 4 bytes of a Float32 value. */
+      namespace Quantisation
+      {
+
+        //! the quantisation step ensuring all vertices lie within \a max_error of their true position
+        inline double step_for_error (const double max_error) { return 2.0 * max_error / std::sqrt (3.0); }
+
+        inline uint64_t zigzag (const int64_t v) { return (uint64_t (v) << 1) ^ uint64_t (v >> 63); }
+        inline int64_t unzigzag (const uint64_t v) { return int64_t (v >> 1) ^ -int64_t (v & 1); }
+
+        //! append \a value to \a out as a variable-length integer
+        inline void put (uint64_t value, std::string& out)
+        {
+          while (value >= 0x80) {
+            out.push_back (char ((value & 0x7F) | 0x80));
+            value >>= 7;
+          }
+          out.push_back (char (value));
+        }
+
+        //! decode a variable-length integer starting at \a p
+        /*! Returns a pointer to the byte following it, or nullptr if it is
+         * not complete before \a end. */
+        inline const char* get (const char* p, const char* end, uint64_t& value)
+        {
+          // fast path for the most common case of a single byte:
+          if (p < end && !(*p & 0x80)) {
+            value = uint8_t (*p);
+            return p+1;
+          }
+          value = 0;
+          for (size_t shift = 0; p < end && shift < 64; shift += 7) {
+            const uint8_t byte = *p++;
+            value |= uint64_t (byte & 0x7F) << shift;
+            if (!(byte & 0x80))
+              return p;
+          }
+          return nullptr;
+        }
+
+
+        //! append the encoded streamline \a tck to \a out
+        template <class ValueType>
+          void encode (const Streamline<ValueType>& tck, const double step, std::string& out)
+          {
+            put (tck.size() + 1, out);
+            int64_t previous[3] = { 0, 0, 0 };
+            for (const auto& p : tck) {
+              assert (p.allFinite());
+              for (size_t axis = 0; axis != 3; ++axis) {
+                const int64_t q = std::llround (p[axis] / step);
+                put (zigzag (q - previous[axis]), out);
+                previous[axis] = q;
+              }
+            }
+          }
+
+
+        //! decode quantised track data into points, as stored in an unquantised file
+        /*! The data can be passed in arbitrary blocks: the state of the
+         * streamline being decoded is kept between calls. */
+        class Decoder
+        { NOMEMALIGN
+          public:
+            Decoder (const double step = 1.0) : step (step), values_left (0), axis (0), done (false) { }
+
+            //! decode the data in [\a start, \a end), appending the vertices to \a points
+            /*! Streamlines are separated by NaN points, and the end of the data
+             * marked by an Inf point. Returns a pointer to the first byte not
+             * consumed, i.e. the start of any incomplete value at the end of
+             * the block, which should be passed again with the following data. */
+            template <class PointType>
+              const char* operator() (const char* start, const char* end, vector<PointType>& points)
+              {
+                using value_type = typename PointType::Scalar;
+                uint64_t value;
+                const char* next;
+                while (!done && (next = get (start, end, value))) {
+                  start = next;
+                  if (values_left) {
+                    q[axis] += unzigzag (value);
+                    if (++axis == 3) {
+                      points.push_back ({ value_type (q[0] * step), value_type (q[1] * step), value_type (q[2] * step) });
+                      axis = 0;
+                    }
+                    if (!--values_left)
+                      points.push_back (PointType::Constant (value_type (NaN)));
+                  }
+                  else if (value) {
+                    values_left = 3 * (value - 1);
+                    q[0] = q[1] = q[2] = 0;
+                    if (!values_left)
+                      points.push_back (PointType::Constant (value_type (NaN)));
+                  }
+                  else {
+                    points.push_back (PointType::Constant (value_type (Inf)));
+                    done = true;
+                  }
+                }
+                return start;
+              }
+
+          private:
+            double step;
+            uint64_t values_left;
+            size_t axis;
+            int64_t q[3];
+            bool done;
+        };
+
+      }
+
+
+    }
+  }
+}
+
+#endif
+
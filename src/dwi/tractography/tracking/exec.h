@@ -36,8 +36,6 @@
 
 #define MAX_NUM_SEED_ATTEMPTS 100000
 
-#define TRACKING_BATCH_SIZE 10
-
 
 
 namespace MR
@@ -64,10 +62,13 @@ namespace MR
                 typename Method::Shared shared (diff_path, properties);
                 WriteKernel writer (shared, destination, properties);
                 Exec<Method> tracker (shared);
-                Thread::run_queue (Thread::multi (tracker), Thread::batch (GeneratedTrack(), TRACKING_BATCH_SIZE), writer);
+                Thread::run_queue (Thread::multi (tracker), Thread::batch (GeneratedTrack()), writer);
 
               } else {
 
+                if (properties.find ("reproducible") != properties.end() && to<bool> (properties["reproducible"]))
+                  throw Exception ("reproducible streamline generation is not compatible with dynamic seeding");
+
                 const std::string& fod_path (properties["seed_dynamic"]);
                 const std::string max_num_tracks = properties["max_num_tracks"];
                 if (max_num_tracks.empty())
@@ -95,11 +96,11 @@ namespace MR
 
                 Thread::run_queue (
                     Thread::multi (tracker),
-                    Thread::batch (GeneratedTrack(), TRACKING_BATCH_SIZE),
+                    Thread::batch (GeneratedTrack()),
                     writer,
-                    Thread::batch (Streamline<>(), TRACKING_BATCH_SIZE),
+                    Thread::batch (Streamline<>()),
                     Thread::multi (mapper),
-                    Thread::batch (SetDixel(), TRACKING_BATCH_SIZE),
+                    Thread::batch (SetDixel()),
                     *seeder);
 
               }
@@ -112,12 +113,13 @@ namespace MR
               S (shared),
               method (shared),
               track_excluded (false),
-              track_included (S.properties.include.size(), false) { }
+              track_included (S.properties.include.size(), false),
+              seeding_failed (false) { }
 
 
             bool operator() (GeneratedTrack& item) {
               rng = &thread_local_RNG;
-              if (!seed_track (item))
+              if (seeding_failed || !seed_track (item))
                 return false;
               if (track_excluded) {
                 item.set_status (GeneratedTrack::status_t::SEED_REJECTED);
@@ -143,6 +145,7 @@ namespace MR
             Method method;
             bool track_excluded;
             vector<bool> track_included;
+            bool seeding_failed;
 
 
             term_t iterate ()
@@ -188,7 +191,7 @@ namespace MR
 
               if (S.properties.seeds.is_finite()) {
 
-                if (!S.properties.seeds.get_seed (method.pos, method.dir))
+                if (!get_seed (tck))
                   return false;
                 if (!method.check_seed() || !method.init()) {
                   track_excluded = true;
@@ -199,7 +202,7 @@ namespace MR
               } else {
 
                 for (size_t num_attempts = 0; num_attempts != MAX_NUM_SEED_ATTEMPTS; ++num_attempts) {
-                  if (S.properties.seeds.get_seed (method.pos, method.dir)) {
+                  if (get_seed (tck, num_attempts)) {
                     if (!(method.check_seed() && method.init())) {
                       track_excluded = true;
                       tck.set_status (GeneratedTrack::status_t::SEED_REJECTED);
@@ -208,6 +211,12 @@ namespace MR
                   }
                 }
                 FAIL ("Failed to find suitable seed point after " + str (MAX_NUM_SEED_ATTEMPTS) + " attempts - aborting");
+                if (S.reproducible) {
+                  // the writer waits for every seed index drawn: pass this
+                  // one on as a rejected seed, and stop on the next call
+                  track_excluded = seeding_failed = true;
+                  return true;
+                }
                 return false;
 
               }
@@ -215,6 +224,25 @@ namespace MR
 
 
 
+            // in reproducible mode, the seed index is drawn along with the
+            // seed point; for infinite seeding mechanisms, further attempts
+            // at the same seed carry on from the same random sequence. Once a
+            // finite seeding mechanism is exhausted, all subsequent indices
+            // fail in the same way, so no track is left waiting for them:
+            bool get_seed (GeneratedTrack& tck, const size_t attempt = 0)
+            {
+              if (!S.reproducible)
+                return S.properties.seeds.get_seed (method.pos, method.dir);
+              std::lock_guard<std::mutex> lock (S.seed_mutex());
+              if (!attempt) {
+                tck.set_index (S.next_seed_index());
+                thread_local_RNG.seed (S.rng_seed (tck.get_index()));
+              }
+              return S.properties.seeds.get_seed (method.pos, method.dir);
+            }
+
+
+
             bool gen_track (GeneratedTrack& tck)
             {
               bool unidirectional = S.unidirectional;
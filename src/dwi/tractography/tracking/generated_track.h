@@ -43,7 +43,7 @@ namespace MR
 
             enum class status_t { INVALID, SEED_REJECTED, TRACK_REJECTED, ACCEPTED };
 
-            GeneratedTrack() : seed_index (0), status (status_t::INVALID) { }
+            GeneratedTrack() : seed_index (0), status (status_t::INVALID), index (0) { }
             void clear() { BaseType::clear(); seed_index = 0; status = status_t::INVALID; }
             size_t get_seed_index() const { return seed_index; }
             status_t get_status() const { return status; }
@@ -51,9 +51,15 @@ namespace MR
             void set_seed_index (const size_t i) { seed_index = i; }
             void set_status (const status_t i) { status = i; }
 
+            // sequential index of the seed from which this track was
+            // generated (only set in reproducible mode):
+            size_t get_index() const { return index; }
+            void set_index (const size_t i) { index = i; }
+
           private:
             size_t seed_index;
             status_t status;
+            size_t index;
 
         };
 
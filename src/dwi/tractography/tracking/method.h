@@ -44,6 +44,7 @@ namespace MR
               dir (0.0, 0.0, 1.0),
               S (shared),
               act_method_additions (S.is_act() ? new ACT::ACT_Method_additions (S) : nullptr),
+              localised (false),
               values (shared.source.size(3)) { }
 
             MethodBase (const MethodBase& that) :
@@ -51,6 +52,7 @@ namespace MR
               dir (0.0, 0.0, 1.0),
               S (that.S),
               act_method_additions (S.is_act() ? new ACT::ACT_Method_additions (S) : nullptr),
+              localised (false),
               uniform (that.uniform),
               values (that.values.size()) { }
 
@@ -71,6 +73,18 @@ namespace MR
               return get_data (source, pos);
             }
 
+            // switch the source image over to the copy held on the NUMA node
+            // of the thread running this method, if applicable. This can
+            // only be done once running within the worker thread itself.
+            template <class InterpolatorType>
+            FORCE_INLINE void use_local_source (InterpolatorType& source)
+            {
+              if (!localised) {
+                S.localise (source);
+                localised = true;
+              }
+            }
+
 
             virtual bool init() = 0;
             virtual term_t next() = 0;
@@ -89,6 +103,7 @@ namespace MR
           private:
             const SharedBase& S;
             std::unique_ptr<ACT::ACT_Method_additions> act_method_additions;
+            bool localised;
 
 
           protected:
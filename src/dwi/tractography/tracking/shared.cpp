@@ -14,6 +14,7 @@
 
 
 #include "dwi/tractography/tracking/shared.h"
+#include "algo/copy.h"
 
 
 namespace MR
@@ -27,8 +28,67 @@ namespace MR
 
 
 
+        namespace
+        {
+          // the source image is sampled at random locations during
+          // tracking, so disable readahead if the data are to be accessed in
+          // place (if they are to be copied into RAM, the copy itself will
+          // benefit from the default readahead):
+          Image<float> open_source (const std::string& path)
+          {
+            auto header = Header::open (path);
+            if (!Image<float>::preload_required (header, Stride::contiguous_along_axis (3, header)))
+              header.set_access_pattern (File::MMap::Access::Random);
+            return header.get_image<float>().with_direct_io (3);
+          }
+        }
+
+
+
+        void SharedBase::localise (Image<float>& image) const
+        {
+          const int node = Thread::numa_node();
+          if (node < 0 || Thread::num_numa_nodes() < 2)
+            return;
+
+          Replica* replica;
+          {
+            std::lock_guard<std::mutex> lock (replica_mutex);
+            if (source_replicas.size() <= size_t (node))
+              source_replicas.resize (node+1);
+            if (!source_replicas[node])
+              source_replicas[node].reset (new Replica);
+            replica = source_replicas[node].get();
+          }
+
+          // only threads on the same node need to wait for the copy:
+          std::lock_guard<std::mutex> lock (replica->mutex);
+          if (!replica->image.valid()) {
+            INFO ("creating copy of image \"" + source.name() + "\" on NUMA node " + str(node));
+            auto copy_of_source = Image<float>::scratch (source, "copy of \"" + source.name() + "\" for NUMA node " + str(node));
+            auto in = source;
+            copy (in, copy_of_source);
+            replica->image = copy_of_source;
+          }
+          image = replica->image;
+        }
+
+
+
+        Math::RNG::result_type SharedBase::rng_seed (const size_t index) const
+        {
+          // mix the seed index into the base seed (SplitMix64 finaliser), so
+          // that consecutive indices yield unrelated random sequences:
+          uint64_t z = (uint64_t (base_rng_seed) << 32) + index + 0x9E3779B97F4A7C15ULL;
+          z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+          z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+          return Math::RNG::result_type (z ^ (z >> 31));
+        }
+
+
+
         SharedBase::SharedBase (const std::string& diff_path, Properties& property_set) :
-            source (Image<float>::open (diff_path).with_direct_io (3)),
+            source (open_source (diff_path)),
             properties (property_set),
             init_dir ({ NaN, NaN, NaN }),
             min_num_points (0),
@@ -43,7 +103,10 @@ namespace MR
             rk4 (false),
             stop_on_all_include (false),
             implicit_max_num_seeds (properties.find ("max_num_seeds") == properties.end()),
-            downsampler ()
+            reproducible (false),
+            downsampler (),
+            base_rng_seed (0),
+            seed_index (0)
 #ifdef DEBUG_TERMINATIONS
           , debug_header (Header::open (properties.find ("act") == properties.end() ? diff_path : properties["act"])),
             transform (debug_header)
@@ -56,6 +119,11 @@ namespace MR
           properties.set (unidirectional, "unidirectional");
           properties.set (rk4, "rk4");
           properties.set (stop_on_all_include, "stop_on_all_include");
+          properties.set (reproducible, "reproducible");
+          if (reproducible) {
+            base_rng_seed = Math::RNG::get_seed();
+            properties["rng_seed"] = str(base_rng_seed);
+          }
 
           properties["source"] = source.name();
 
@@ -17,10 +17,12 @@
 #define __dwi_tractography_tracking_shared_h__
 
 #include <atomic>
+#include <mutex>
 
 #include "header.h"
 #include "image.h"
 #include "memory.h"
+#include "math/rng.h"
 #include "transform.h"
 #include "dwi/tractography/properties.h"
 #include "dwi/tractography/roi.h"
@@ -62,7 +64,7 @@ namespace MR
             float max_angle, max_angle_rk4, cos_max_angle, cos_max_angle_rk4;
             float step_size, threshold, init_threshold;
             size_t max_seed_attempts;
-            bool unidirectional, rk4, stop_on_all_include, implicit_max_num_seeds;
+            bool unidirectional, rk4, stop_on_all_include, implicit_max_num_seeds, reproducible;
             DWI::Tractography::Resampling::Downsampler downsampler;
 
             // Additional members for ACT
@@ -83,6 +85,23 @@ namespace MR
             virtual float internal_step_size() const { return step_size; }
 
 
+            // If worker threads are pinned across several NUMA nodes, point
+            // image at a copy of the source image held on the node of the
+            // calling thread (created on first use by that thread, so that
+            // its memory is local to the node):
+            void localise (Image<float>& image) const;
+
+
+            // In reproducible mode, each seed is given a sequential index,
+            // and the RNG reseeded from it before the seed point is drawn, so
+            // that the streamline generated does not depend on which thread
+            // processes it. Seeds must be drawn under lock, since finite
+            // seeding mechanisms yield seed points in sequence.
+            std::mutex& seed_mutex () const { return seed_index_mutex; }
+            size_t next_seed_index () const { return seed_index++; }
+            Math::RNG::result_type rng_seed (const size_t index) const;
+
+
             void add_termination (const term_t i)   const { terminations[i].fetch_add (1, std::memory_order_relaxed); }
             void add_rejection   (const reject_t i) const { rejections[i]  .fetch_add (1, std::memory_order_relaxed); }
 
@@ -98,6 +117,19 @@ namespace MR
 
             std::unique_ptr<ACT::ACT_Shared_additions> act_shared_additions;
 
+            // copies of the source image per NUMA node, each created under
+            // its own lock; replica_mutex only guards the list itself:
+            struct Replica { MEMALIGN(Replica)
+              std::mutex mutex;
+              Image<float> image;
+            };
+            mutable vector<std::unique_ptr<Replica>> source_replicas;
+            mutable std::mutex replica_mutex;
+
+            Math::RNG::result_type base_rng_seed;
+            mutable size_t seed_index;
+            mutable std::mutex seed_index_mutex;
+
 #ifdef DEBUG_TERMINATIONS
             Header debug_header;
             Image<uint32_t>* debug_images[TERMINATION_REASON_COUNT];
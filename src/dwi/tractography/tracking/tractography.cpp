@@ -83,7 +83,15 @@ namespace MR
 
       + Option ("downsample", "downsample the generated streamlines to reduce output file size "
                               "(default is (samples-1) for iFOD2, no downsampling for all other algorithms)")
-          + Argument ("factor").type_integer (2);
+          + Argument ("factor").type_integer (2)
+
+      + Option ("reproducible", "generate exactly the same streamlines regardless of the number of "
+                                "threads used or the order in which they complete, by drawing the "
+                                "random numbers for each streamline from a sequence determined by its "
+                                "seed index, and writing streamlines in seed order. Identical output "
+                                "can then be obtained across runs by setting the MRTRIX_RNG_SEED "
+                                "environment variable (the value used is stored in the output header "
+                                "as \"rng_seed\"). Not compatible with dynamic seeding.");
 
 
 
@@ -142,6 +150,9 @@ namespace MR
         opt = get_options ("downsample");
         if (opt.size()) properties["downsample_factor"] = str<unsigned int> (opt[0][0]);
 
+        opt = get_options ("reproducible");
+        if (opt.size()) properties["reproducible"] = "1";
+
         opt = get_options ("grad");
         if (opt.size()) properties["DW_scheme"] = std::string (opt[0][0]);
 
@@ -27,6 +27,28 @@ namespace MR
 
 
           bool WriteKernel::operator() (const GeneratedTrack& tck)
+          {
+            if (!S.reproducible)
+              return write (tck);
+
+            if (tck.get_index() != next_index) {
+              pending.emplace (tck.get_index(), tck);
+              return !complete();
+            }
+            if (!write (tck))
+              return false;
+            ++next_index;
+            for (auto next = pending.begin(); next != pending.end() && next->first == next_index; next = pending.erase (next)) {
+              if (!write (next->second))
+                return false;
+              ++next_index;
+            }
+            return true;
+          }
+
+
+
+          bool WriteKernel::write (const GeneratedTrack& tck)
           {
             if (complete())
               return false;
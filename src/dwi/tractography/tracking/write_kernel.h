@@ -17,6 +17,7 @@
 #define __dwi_tractography_tracking_write_kernel_h__
 
 #include <cinttypes>
+#include <map>
 #include <string>
 
 #include "timer.h"
@@ -58,7 +59,8 @@ namespace MR
                 streamlines (0),
                 selected (0),
                 progress (printf ("       0 seeds,        0 streamlines,        0 selected", 0, 0), always_increment ? S.max_num_seeds : S.max_num_tracks),
-                early_exit (shared)
+                early_exit (shared),
+                next_index (0)
           {
             const auto p = properties.find ("seed_output");
             if (p != properties.end()) {
@@ -99,6 +101,13 @@ namespace MR
           std::unique_ptr<File::OFStream> output_seeds;
           ProgressBar progress;
           EarlyExit early_exit;
+
+          // in reproducible mode, tracks received ahead of those with lower
+          // seed index are held back until they can be written in order:
+          std::map<size_t, GeneratedTrack> pending;
+          size_t next_index;
+
+          bool write (const GeneratedTrack&);
       };
 
 
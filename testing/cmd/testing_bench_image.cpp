@@ -0,0 +1,112 @@
+/*
+ * Copyright (c) 2008-2018 the MRtrix3 contributors.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at http://mozilla.org/MPL/2.0/
+ *
+ * MRtrix3 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * For more details, see http://www.mrtrix.org/
+ */
+
+
+#include "command.h"
+#include "datatype.h"
+#include "image.h"
+#include "algo/loop.h"
+#include "file/utils.h"
+
+#include "benchmark.h"
+
+using namespace MR;
+using namespace App;
+
+#define DEFAULT_SIZE 64
+
+const char* datatypes[] = {
+  "bit", "int8", "uint8", "int16le", "int16be", "uint16le", "int32le", "uint32be",
+  "float32le", "float32be", "float64le", "float64be", nullptr
+};
+
+void usage ()
+{
+  AUTHOR = "MRtrix3 contributors";
+
+  SYNOPSIS = "Measure the time taken per voxel to read & write image data using Image::value()";
+
+  DESCRIPTION
+  + "A temporary image is created for each of the data types: bit, int8, uint8, "
+    "int16le, int16be, uint16le, int32le, uint32be, float32le, float32be, float64le "
+    "and float64be, and all of its voxels are then read and written in turn, using a single thread. "
+    "This gives the cost of access via Image::value(), including any type & byte "
+    "order conversion required. The same operations are also measured on a scratch "
+    "image, which is always accessed directly.";
+
+  OPTIONS
+  + Option ("size", "the size of the (cubic) test images (default: " + str(DEFAULT_SIZE) + ").")
+    + Argument ("voxels").type_integer (1)
+
+  + Testing::Benchmark_Options;
+}
+
+
+
+void benchmark_image (const std::string& label, Image<float>& image)
+{
+  const size_t num_voxels = voxel_count (image);
+
+  Testing::benchmark (label + " read", [&] () {
+      float sum = 0.0f;
+      for (auto l = Loop (image) (image); l; ++l)
+        sum += image.value();
+      Testing::do_not_optimise (sum);
+      }, num_voxels);
+
+  Testing::benchmark (label + " write", [&] () {
+      float value = 0.0f;
+      for (auto l = Loop (image) (image); l; ++l)
+        image.value() = (value += 1.0f);
+      }, num_voxels);
+}
+
+
+
+void run ()
+{
+  const size_t size = get_option_value ("size", DEFAULT_SIZE);
+
+  Header header;
+  header.ndim() = 3;
+  for (size_t n = 0; n < 3; ++n) {
+    header.size(n) = size;
+    header.spacing(n) = 1.0;
+  }
+  header.transform().setIdentity();
+
+  header.datatype() = DataType::Float32;
+  auto scratch = Image<float>::scratch (header);
+  benchmark_image ("scratch", scratch);
+
+  for (const char** type = datatypes; *type; ++type) {
+    header.datatype() = DataType::parse (*type);
+    // obtain a unique filename, but let the image handler create the file:
+    const std::string filename = File::create_tempfile (0, "mif");
+    File::unlink (filename);
+    try {
+      {
+        auto image = Image<float>::create (filename, header);
+        benchmark_image (*type, image);
+      }
+      File::unlink (filename);
+    }
+    catch (...) {
+      if (Path::exists (filename))
+        File::unlink (filename);
+      throw;
+    }
+  }
+}
+
@@ -0,0 +1,124 @@
+/*
+ * Copyright (c) 2008-2018 the MRtrix3 contributors.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at http://mozilla.org/MPL/2.0/
+ *
+ * MRtrix3 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * For more details, see http://www.mrtrix.org/
+ */
+
+
+#include "command.h"
+#include "image.h"
+#include "math/rng.h"
+#include "interp/linear.h"
+#include "interp/cubic.h"
+#include "interp/sinc.h"
+
+#include "benchmark.h"
+
+using namespace MR;
+using namespace App;
+
+#define DEFAULT_SIZE 64
+#define NUM_POSITIONS 100000
+
+void usage ()
+{
+  AUTHOR = "MRtrix3 contributors";
+
+  SYNOPSIS = "Measure the time taken per call to the image interpolators";
+
+  DESCRIPTION
+  + "The Interp::Linear, Interp::Cubic and Interp::Sinc interpolators are "
+    "applied to a scratch image filled with random values, at a fixed set of "
+    "random positions within the field of view. For each interpolator, the time "
+    "taken to set the position and retrieve the interpolated value is reported; "
+    "for the linear and cubic interpolators, the same is also reported for the "
+    "image gradient.";
+
+  OPTIONS
+  + Option ("size", "the size of the (cubic) test image (default: " + str(DEFAULT_SIZE) + ").")
+    + Argument ("voxels").type_integer (4)
+
+  + Testing::Benchmark_Options;
+}
+
+
+
+template <class InterpType>
+void benchmark_value (const std::string& label, InterpType& interp, const vector<Eigen::Vector3>& positions)
+{
+  Testing::benchmark (label + " value", [&] () {
+      float sum = 0.0f;
+      for (const auto& pos : positions) {
+        interp.voxel (pos);
+        sum += interp.value();
+      }
+      Testing::do_not_optimise (sum);
+      }, positions.size());
+}
+
+
+template <class InterpType>
+void benchmark_gradient (const std::string& label, InterpType& interp, const vector<Eigen::Vector3>& positions)
+{
+  Testing::benchmark (label + " gradient", [&] () {
+      Eigen::Matrix<float,1,3> sum (0.0f, 0.0f, 0.0f);
+      for (const auto& pos : positions) {
+        interp.voxel (pos);
+        sum += interp.gradient();
+      }
+      Testing::do_not_optimise (sum);
+      }, positions.size());
+}
+
+
+
+void run ()
+{
+  const size_t size = get_option_value ("size", DEFAULT_SIZE);
+
+  Header header;
+  header.ndim() = 3;
+  for (size_t n = 0; n < 3; ++n) {
+    header.size(n) = size;
+    header.spacing(n) = 1.0;
+  }
+  header.transform().setIdentity();
+  header.datatype() = DataType::Float32;
+
+  auto image = Image<float>::scratch (header);
+  Math::RNG::Uniform<float> rng;
+  for (auto l = Loop (image) (image); l; ++l)
+    image.value() = rng();
+
+  // positions well within the field of view, so that all interpolators
+  // operate on the same (in-bounds) code path:
+  Math::RNG::Uniform<default_type> rng_pos;
+  vector<Eigen::Vector3> positions (NUM_POSITIONS);
+  for (auto& pos : positions)
+    for (size_t n = 0; n < 3; ++n)
+      pos[n] = 3.0 + rng_pos() * (size - 7.0);
+
+  Interp::Linear<Image<float>> linear (image);
+  benchmark_value ("linear", linear, positions);
+
+  Interp::LinearInterp<Image<float>, Interp::LinearInterpProcessingType::Derivative> linear_gradient (image);
+  benchmark_gradient ("linear", linear_gradient, positions);
+
+  Interp::Cubic<Image<float>> cubic (image);
+  benchmark_value ("cubic", cubic, positions);
+
+  Interp::SplineInterp<Image<float>, Math::HermiteSpline<float>, Math::SplineProcessingType::Derivative> cubic_gradient (image);
+  benchmark_gradient ("cubic", cubic_gradient, positions);
+
+  Interp::Sinc<Image<float>> sinc (image);
+  benchmark_value ("sinc", sinc, positions);
+}
+
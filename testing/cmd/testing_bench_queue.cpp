@@ -0,0 +1,106 @@
+/*
+ * Copyright (c) 2008-2018 the MRtrix3 contributors.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at http://mozilla.org/MPL/2.0/
+ *
+ * MRtrix3 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * For more details, see http://www.mrtrix.org/
+ */
+
+
+
+#include "command.h"
+#include "thread_queue.h"
+
+#include "benchmark.h"
+
+using namespace MR;
+using namespace App;
+
+#define DEFAULT_NUM_ITEMS 1000000
+
+void usage ()
+{
+  AUTHOR = "MRtrix3 contributors";
+
+  SYNOPSIS = "Measure the throughput of the Thread::Queue";
+
+  DESCRIPTION
+  + "Items (of type size_t) are passed from a source thread to one or more "
+    "sink threads via Thread::run_queue(), and the time taken per item "
+    "reported. This is measured for one sink and, if more than one thread is "
+    "available, for as many sinks as threads (as set using the -nthreads "
+    "option), with items passed individually, in batches of fixed size, and "
+    "with adaptive batching (the default for Thread::batch())."
+  + "Since the source and sink perform no work, this gives the overhead per "
+    "item of the push and pop operations.";
+
+  OPTIONS
+  + Option ("items", "the number of items passed per run (default: " + str(DEFAULT_NUM_ITEMS) + ").")
+    + Argument ("num").type_integer (1)
+
+  + Testing::Benchmark_Options;
+}
+
+
+
+class Source { NOMEMALIGN
+  public:
+    Source (size_t num) : count (0), num (num) { }
+    bool operator() (size_t& item) {
+      item = count++;
+      return item < num;
+    }
+  private:
+    size_t count;
+    const size_t num;
+};
+
+
+class Sink { NOMEMALIGN
+  public:
+    bool operator() (const size_t& item) {
+      Testing::do_not_optimise (item);
+      return true;
+    }
+};
+
+
+
+void run ()
+{
+  const size_t num_items = get_option_value ("items", DEFAULT_NUM_ITEMS);
+  const size_t nthreads = Thread::number_of_threads();
+
+  Testing::benchmark ("queue (1 sink)", [&] () {
+      Thread::run_queue (Source (num_items), size_t(), Sink());
+      }, num_items);
+
+  Testing::benchmark ("queue, batch 1024 (1 sink)", [&] () {
+      Thread::run_queue (Source (num_items), Thread::batch (size_t(), 1024), Sink());
+      }, num_items);
+
+  Testing::benchmark ("queue, adaptive batch (1 sink)", [&] () {
+      Thread::run_queue (Source (num_items), Thread::batch (size_t()), Sink());
+      }, num_items);
+
+  if (nthreads < 2)
+    return;
+
+  Testing::benchmark ("queue (" + str(nthreads) + " sinks)", [&] () {
+      Thread::run_queue (Source (num_items), size_t(), Thread::multi (Sink(), nthreads));
+      }, num_items);
+
+  Testing::benchmark ("queue, batch 1024 (" + str(nthreads) + " sinks)", [&] () {
+      Thread::run_queue (Source (num_items), Thread::batch (size_t(), 1024), Thread::multi (Sink(), nthreads));
+      }, num_items);
+
+  Testing::benchmark ("queue, adaptive batch (" + str(nthreads) + " sinks)", [&] () {
+      Thread::run_queue (Source (num_items), Thread::batch (size_t()), Thread::multi (Sink(), nthreads));
+      }, num_items);
+}
@@ -0,0 +1,81 @@
+/*
+ * Copyright (c) 2008-2018 the MRtrix3 contributors.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at http://mozilla.org/MPL/2.0/
+ *
+ * MRtrix3 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * For more details, see http://www.mrtrix.org/
+ */
+
+
+
+#include "command.h"
+#include "math/rng.h"
+#include "math/SH.h"
+
+#include "benchmark.h"
+
+using namespace MR;
+using namespace App;
+
+#define DEFAULT_LMAX 8
+#define NUM_DIRECTIONS 10000
+
+void usage ()
+{
+  AUTHOR = "MRtrix3 contributors";
+
+  SYNOPSIS = "Measure the time taken to evaluate a spherical harmonic series along a given direction";
+
+  DESCRIPTION
+  + "A random set of SH coefficients is evaluated along a fixed set of random "
+    "unit directions, using Math::SH::value() (which computes the associated "
+    "Legendre functions on the fly) and Math::SH::PrecomputedAL::value() (which "
+    "interpolates them from a lookup table), for each even harmonic order up to "
+    "the maximum specified.";
+
+  OPTIONS
+  + Option ("lmax", "the maximum harmonic order to test (default: " + str(DEFAULT_LMAX) + ").")
+    + Argument ("order").type_integer (0, 30)
+
+  + Testing::Benchmark_Options;
+}
+
+
+
+void run ()
+{
+  const int lmax = get_option_value ("lmax", DEFAULT_LMAX);
+
+  Math::RNG::Normal<float> rng;
+  vector<Eigen::Vector3f> directions (NUM_DIRECTIONS);
+  for (auto& dir : directions)
+    dir = Eigen::Vector3f (rng(), rng(), rng()).normalized();
+
+  for (int l = 0; l <= lmax; l += 2) {
+    Eigen::VectorXf coefs (Math::SH::NforL (l));
+    for (ssize_t n = 0; n < coefs.size(); ++n)
+      coefs[n] = rng();
+
+    Testing::benchmark ("SH::value (lmax = " + str(l) + ")", [&] () {
+        float sum = 0.0f;
+        for (const auto& dir : directions)
+          sum += Math::SH::value (coefs, dir, l);
+        Testing::do_not_optimise (sum);
+        }, directions.size());
+
+    Math::SH::PrecomputedAL<float> precomputed (l);
+    Testing::benchmark ("PrecomputedAL::value (lmax = " + str(l) + ")", [&] () {
+        float sum = 0.0f;
+        for (const auto& dir : directions)
+          sum += precomputed.value (coefs, dir);
+        Testing::do_not_optimise (sum);
+        }, directions.size());
+  }
+}
+
@@ -0,0 +1,132 @@
+/*
+ * Copyright (c) 2008-2018 the MRtrix3 contributors.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at http://mozilla.org/MPL/2.0/
+ *
+ * MRtrix3 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * For more details, see http://www.mrtrix.org/
+ */
+
+
+
+#include "command.h"
+#include "math/rng.h"
+#include "file/utils.h"
+#include "dwi/tractography/file.h"
+#include "dwi/tractography/properties.h"
+
+#include "benchmark.h"
+
+using namespace MR;
+using namespace App;
+using namespace MR::DWI::Tractography;
+
+#define DEFAULT_NUM_TRACKS 10000
+#define DEFAULT_NUM_POINTS 200
+
+void usage ()
+{
+  AUTHOR = "MRtrix3 contributors";
+
+  SYNOPSIS = "Measure the rate at which streamline vertices are read from a .tck file";
+
+  DESCRIPTION
+  + "Unless an existing track file is supplied via the -tracks option, a "
+    "temporary file is generated, containing random walk streamlines. The file "
+    "is then read in full repeatedly using Tractography::Reader, and the time "
+    "taken per streamline vertex reported. Note that the file will typically "
+    "reside in the filesystem cache after the first pass, so that this "
+    "measures the cost of decoding rather than that of the storage device.";
+
+  OPTIONS
+  + Option ("tracks", "read the track file specified, rather than generating synthetic data.")
+    + Argument ("file").type_tracks_in ()
+
+  + Option ("number", "the number of streamlines to generate (default: " + str(DEFAULT_NUM_TRACKS) + ").")
+    + Argument ("num").type_integer (1)
+
+  + Option ("points", "the number of vertices per generated streamline (default: " + str(DEFAULT_NUM_POINTS) + ").")
+    + Argument ("num").type_integer (2)
+
+  + Testing::Benchmark_Options;
+}
+
+
+
+void generate (const std::string& path)
+{
+  const size_t num_tracks = get_option_value ("number", DEFAULT_NUM_TRACKS);
+  const size_t num_points = get_option_value ("points", DEFAULT_NUM_POINTS);
+
+  Properties properties;
+  Writer<float> writer (path, properties);
+  Math::RNG::Normal<float> rng;
+  Streamline<float> tck (num_points);
+  for (size_t n = 0; n < num_tracks; ++n) {
+    tck[0] = { 10.0f*rng(), 10.0f*rng(), 10.0f*rng() };
+    for (size_t i = 1; i < num_points; ++i)
+      tck[i] = tck[i-1] + 0.5f * Eigen::Vector3f (rng(), rng(), rng()).normalized();
+    writer (tck);
+  }
+}
+
+
+
+size_t count_points (const std::string& path)
+{
+  Properties properties;
+  Reader<float> reader (path, properties);
+  Streamline<float> tck;
+  size_t count = 0;
+  while (reader (tck))
+    count += tck.size();
+  return count;
+}
+
+
+
+void run ()
+{
+  std::string path;
+  auto opt = get_options ("tracks");
+  if (opt.size())
+    path = str(opt[0][0]);
+  else {
+    // obtain a unique filename, but let the Writer create the file:
+    path = File::create_tempfile (0, "tck");
+    File::unlink (path);
+    try {
+      generate (path);
+    }
+    catch (...) {
+      if (Path::exists (path))
+        File::unlink (path);
+      throw;
+    }
+  }
+
+  try {
+    const size_t num_points = count_points (path);
+    Testing::benchmark ("Tractography::Reader", [&] () {
+        Properties properties;
+        Reader<float> reader (path, properties);
+        Streamline<float> tck;
+        while (reader (tck))
+          Testing::do_not_optimise (tck.data());
+        }, num_points);
+  }
+  catch (...) {
+    if (!opt.size())
+      File::unlink (path);
+    throw;
+  }
+
+  if (!opt.size())
+    File::unlink (path);
+}
+
@@ -0,0 +1,82 @@
+/*
+ * Copyright (c) 2008-2018 the MRtrix3 contributors.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at http://mozilla.org/MPL/2.0/
+ *
+ * MRtrix3 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * For more details, see http://www.mrtrix.org/
+ */
+
+
+
+#include "command.h"
+#include "image.h"
+#include "algo/loop.h"
+#include "image_span.h"
+#include "algo/threaded_loop.h"
+
+#include "benchmark.h"
+
+using namespace MR;
+using namespace App;
+
+#define DEFAULT_SIZE 128
+
+void usage ()
+{
+  AUTHOR = "MRtrix3 contributors";
+
+  SYNOPSIS = "Measure the overhead per voxel of the ThreadedLoop";
+
+  DESCRIPTION
+  + "A trivial operation (incrementing the voxel value) is applied to all voxels "
+    "of a scratch image, first using a plain single-threaded Loop, then using "
+    "a ThreadedLoop with the number of threads set via the -nthreads option, "
+    "both with the per-voxel (run()) and the per-row (run_span()) forms of the kernel. "
+    "Since the operation itself is negligible, the difference gives the "
+    "overhead of the threading framework itself.";
+
+  OPTIONS
+  + Option ("size", "the size of the (cubic) test image (default: " + str(DEFAULT_SIZE) + ").")
+    + Argument ("voxels").type_integer (1)
+
+  + Testing::Benchmark_Options;
+}
+
+
+
+void run ()
+{
+  const size_t size = get_option_value ("size", DEFAULT_SIZE);
+
+  Header header;
+  header.ndim() = 3;
+  for (size_t n = 0; n < 3; ++n) {
+    header.size(n) = size;
+    header.spacing(n) = 1.0;
+  }
+  header.transform().setIdentity();
+  header.datatype() = DataType::Float32;
+
+  auto image = Image<float>::scratch (header);
+  const size_t num_voxels = voxel_count (image);
+
+  Testing::benchmark ("Loop", [&] () {
+      for (auto l = Loop (image) (image); l; ++l)
+        image.value() += 1.0f;
+      }, num_voxels);
+
+  Testing::benchmark ("ThreadedLoop (" + str(Thread::number_of_threads()) + " threads, per voxel)", [&] () {
+      ThreadedLoop (image).run ([] (Image<float>& vox) { vox.value() += 1.0f; }, image);
+      }, num_voxels);
+
+  Testing::benchmark ("ThreadedLoop (" + str(Thread::number_of_threads()) + " threads, per row)", [&] () {
+      ThreadedLoop (image, 0, 3).run_span ([] (ImageSpan<float>& row) { row.array() += 1.0f; }, image);
+      }, num_voxels);
+}
+
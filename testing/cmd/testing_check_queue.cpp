@@ -0,0 +1,179 @@
+/*
+ * Copyright (c) 2008-2018 the MRtrix3 contributors.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at http://mozilla.org/MPL/2.0/
+ *
+ * MRtrix3 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * For more details, see http://www.mrtrix.org/
+ */
+
+
+
+#include <atomic>
+
+#include "command.h"
+#include "thread_queue.h"
+
+using namespace MR;
+using namespace App;
+
+#define DEFAULT_NUM_ITEMS 1000000
+
+void usage ()
+{
+  AUTHOR = "MRtrix3 contributors";
+
+  SYNOPSIS = "Verify that items passed through Thread::run_queue() arrive exactly once";
+
+  DESCRIPTION
+  + "Items are passed from several source threads, optionally via several "
+    "pipe threads, to several sink threads (as many of each as set using the "
+    "-nthreads option), individually and in batches, and for item types "
+    "handled by both the lock-free and the locking queue implementations. "
+    "The command fails if any item is lost or delivered more than once.";
+
+  OPTIONS
+  + Option ("items", "the number of items passed per run (default: " + str(DEFAULT_NUM_ITEMS) + ").")
+    + Argument ("num").type_integer (1);
+}
+
+
+
+// all items are numbered, and converted to and from the type passed along
+// the queue:
+template <class ItemType> struct Convert { NOMEMALIGN
+  static void set (ItemType& item, size_t n) { item = n; }
+  static size_t get (const ItemType& item) { return item; }
+};
+
+template <> struct Convert<Eigen::Vector4d> { NOMEMALIGN
+  static void set (Eigen::Vector4d& item, size_t n) { item = Eigen::Vector4d (n, 0.0, 1.0, 2.0); }
+  static size_t get (const Eigen::Vector4d& item) { return item[0]; }
+};
+
+// a type that may throw when moved, and so requires the locking queue:
+struct Copyable { NOMEMALIGN
+  Copyable () : value (0) { }
+  Copyable (const Copyable& that) : value (that.value) { }
+  Copyable& operator= (const Copyable&) = default;
+  size_t value;
+};
+
+template <> struct Convert<Copyable> { NOMEMALIGN
+  static void set (Copyable& item, size_t n) { item.value = n; }
+  static size_t get (const Copyable& item) { return item.value; }
+};
+
+template <class ItemType>
+ItemType make_item (size_t n)
+{
+  ItemType item;
+  Convert<ItemType>::set (item, n);
+  return item;
+}
+
+
+
+template <class ItemType>
+class Source { NOMEMALIGN
+  public:
+    Source (std::atomic<size_t>& next, size_t num) : next (next), num (num) { }
+    bool operator() (ItemType& item) {
+      const size_t n = next++;
+      if (n >= num)
+        return false;
+      Convert<ItemType>::set (item, n);
+      return true;
+    }
+  private:
+    std::atomic<size_t>& next;
+    const size_t num;
+};
+
+
+template <class ItemType>
+class Pipe { NOMEMALIGN
+  public:
+    bool operator() (const ItemType& in, ItemType& out) {
+      out = in;
+      return true;
+    }
+};
+
+
+template <class ItemType>
+class Sink { NOMEMALIGN
+  public:
+    Sink (vector<std::atomic<uint8_t>>& received) : received (received) { }
+    bool operator() (const ItemType& item) {
+      const size_t n = Convert<ItemType>::get (item);
+      if (n >= received.size())
+        throw Exception ("invalid item " + str(n) + " received");
+      ++received[n];
+      return true;
+    }
+  private:
+    vector<std::atomic<uint8_t>>& received;
+};
+
+
+
+template <class ItemType, class QueueType>
+void check (const std::string& description, const QueueType& queue_type, size_t num_items, size_t nthreads, bool with_pipe)
+{
+  CONSOLE ("checking " + description + (with_pipe ? " via pipe" : ""));
+  std::atomic<size_t> next (0);
+  vector<std::atomic<uint8_t>> received (num_items);
+  for (auto& r : received)
+    r = 0;
+
+  Source<ItemType> source (next, num_items);
+  Sink<ItemType> sink (received);
+  if (with_pipe)
+    Thread::run_queue (Thread::multi (source, nthreads), queue_type, Thread::multi (Pipe<ItemType>(), nthreads), queue_type, Thread::multi (sink, nthreads));
+  else
+    Thread::run_queue (Thread::multi (source, nthreads), queue_type, Thread::multi (sink, nthreads));
+
+  size_t lost = 0, duplicated = 0;
+  for (const auto& r : received) {
+    if (!r) ++lost;
+    else if (r > 1) ++duplicated;
+  }
+  if (lost || duplicated)
+    throw Exception ("Thread::run_queue() with " + description + ": "
+        + str(lost) + " items lost, " + str(duplicated) + " items delivered more than once");
+}
+
+
+
+template <class ItemType>
+void check_type (const std::string& type_name, size_t num_items, size_t nthreads)
+{
+  const ItemType item = make_item<ItemType> (0);
+  for (bool with_pipe : { false, true }) {
+    check<ItemType> (type_name + " items", item, num_items, nthreads, with_pipe);
+    check<ItemType> (type_name + " items in batches of 128", Thread::batch (item, 128), num_items, nthreads, with_pipe);
+    check<ItemType> (type_name + " items in adaptive batches", Thread::batch (item), num_items, nthreads, with_pipe);
+  }
+}
+
+
+
+void run ()
+{
+  const size_t num_items = get_option_value ("items", DEFAULT_NUM_ITEMS);
+  const size_t nthreads = std::max (Thread::number_of_threads(), size_t(1));
+
+  // handled by LockFreeQueue:
+  check_type<size_t> ("size_t", num_items, nthreads);
+  check_type<Eigen::Vector4d> ("Eigen::Vector4d", num_items, nthreads);
+  // handled by Queue:
+  static_assert (!std::is_nothrow_move_constructible<Copyable>::value, "Copyable should not be handled by LockFreeQueue");
+  check_type<Copyable> ("Copyable", num_items, nthreads);
+}
+
@@ -0,0 +1,249 @@
+/*
+ * Copyright (c) 2008-2018 the MRtrix3 contributors.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at http://mozilla.org/MPL/2.0/
+ *
+ * MRtrix3 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * For more details, see http://www.mrtrix.org/
+ */
+
+
+#include "command.h"
+#include "image.h"
+#include "algo/threaded_loop.h"
+#include "file/ofstream.h"
+#include "dwi/gradient.h"
+#include "math/legendre.h"
+
+using namespace MR;
+using namespace App;
+
+#define DEFAULT_NUM_DIRECTIONS 60
+#define DEFAULT_BVALUE 3000.0
+#define DEFAULT_NOISE 0.02
+
+// diffusivities in mm^2/s:
+#define AXIAL_DIFFUSIVITY 1.7e-3
+#define RADIAL_DIFFUSIVITY 0.2e-3
+#define ISOTROPIC_DIFFUSIVITY 0.7e-3
+#define ISOTROPIC_FRACTION 0.1
+#define S0 1000.0
+
+void usage ()
+{
+  AUTHOR = "MRtrix3 contributors";
+
+  SYNOPSIS = "Generate a synthetic diffusion-weighted phantom for benchmarking";
+
+  DESCRIPTION
+  + "The phantom consists of an ellipsoidal volume containing three fibre bundles: "
+    "two straight bundles running along the x and y axes, and a curved bundle in "
+    "the x-z plane, giving rise to regions of two- and three-way crossing fibres. "
+    "The remainder of the volume contains isotropic diffusion only."
+  + "The output is entirely determined by the parameters provided: the Rician noise "
+    "is derived from a hash of the voxel and volume indices, so that the result "
+    "does not depend on the number of threads used.";
+
+  ARGUMENTS
+  + Argument ("size", "the spatial dimensions of the phantom.").type_sequence_int ()
+  + Argument ("dwi", "the output DWI series.").type_image_out ();
+
+  OPTIONS
+  + Option ("directions", "the number of diffusion-weighted directions (default: " + str(DEFAULT_NUM_DIRECTIONS) + "); "
+      "one b=0 volume is added for every 10 directions.")
+    + Argument ("num").type_integer (6)
+
+  + Option ("bvalue", "the b-value of the diffusion-weighted volumes (default: " + str(DEFAULT_BVALUE) + ").")
+    + Argument ("value").type_float (0.0)
+
+  + Option ("noise", "the standard deviation of the noise, relative to the b=0 signal (default: " + str(DEFAULT_NOISE) + ").")
+    + Argument ("sigma").type_float (0.0)
+
+  + Option ("mask", "write a mask of the phantom volume to the image specified.")
+    + Argument ("image").type_image_out ()
+
+  + Option ("response", "write the exact single-fibre response function for the "
+      "diffusion-weighted shell, as zonal spherical harmonic coefficients (as used by dwi2fod).")
+    + Argument ("file").type_file_out ();
+}
+
+
+
+
+// deterministic pseudo-random number generation from a counter (SplitMix64):
+inline uint64_t hash (uint64_t x)
+{
+  x += 0x9E3779B97F4A7C15ULL;
+  x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+  return x ^ (x >> 31);
+}
+
+inline double uniform (uint64_t x)
+{
+  return (hash (x) >> 11) * (1.0 / 9007199254740992.0) + 0.5 / 9007199254740992.0;
+}
+
+inline double gaussian (uint64_t x)
+{
+  return std::sqrt (-2.0 * std::log (uniform (2*x))) * std::cos (2.0 * Math::pi * uniform (2*x+1));
+}
+
+
+
+// directions evenly distributed over the hemisphere (Fibonacci lattice):
+Eigen::MatrixXd gen_scheme (size_t num_directions, double bvalue)
+{
+  const size_t num_b0 = std::max (size_t(1), num_directions / 10);
+  Eigen::MatrixXd grad = Eigen::MatrixXd::Zero (num_b0 + num_directions, 4);
+  const double golden_angle = Math::pi * (3.0 - std::sqrt (5.0));
+  for (size_t n = 0; n < num_directions; ++n) {
+    const double z = 1.0 - (n + 0.5) / num_directions;
+    const double r = std::sqrt (1.0 - z*z);
+    const double phi = n * golden_angle;
+    grad.row (num_b0 + n) << r * std::cos (phi), r * std::sin (phi), z, bvalue;
+  }
+  return grad;
+}
+
+
+
+inline double fibre_signal (double cos_angle, double bvalue)
+{
+  return std::exp (-bvalue * (RADIAL_DIFFUSIVITY + (AXIAL_DIFFUSIVITY - RADIAL_DIFFUSIVITY) * cos_angle * cos_angle));
+}
+
+
+
+class Phantom { NOMEMALIGN
+  public:
+    Phantom (const Header& header, const Eigen::MatrixXd& grad, double noise) :
+      grad (grad),
+      noise (noise),
+      dim { size_t(header.size(0)), size_t(header.size(1)), size_t(header.size(2)) } { }
+
+    // fibre directions present at a normalised position within [0,1]^3:
+    vector<Eigen::Vector3d> fibres (const Eigen::Vector3d& u) const
+    {
+      vector<Eigen::Vector3d> dirs;
+      if (std::abs (u[1] - 0.5) < 0.15 && std::abs (u[2] - 0.5) < 0.25)
+        dirs.push_back ({ 1.0, 0.0, 0.0 });
+      if (std::abs (u[0] - 0.5) < 0.15 && std::abs (u[2] - 0.5) < 0.25)
+        dirs.push_back ({ 0.0, 1.0, 0.0 });
+      const double r = std::sqrt (Math::pow2 (u[0] - 0.5) + Math::pow2 (u[2] - 0.1));
+      if (r > 0.35 && r < 0.5 && std::abs (u[1] - 0.5) < 0.3)
+        dirs.push_back (Eigen::Vector3d (-(u[2] - 0.1), 0.0, u[0] - 0.5) / r);
+      return dirs;
+    }
+
+    bool inside (const Eigen::Vector3d& u) const
+    {
+      return (Math::pow2 (2.0*u[0]-1.0) + Math::pow2 (2.0*u[1]-1.0) + Math::pow2 (2.0*u[2]-1.0)) <= 1.0;
+    }
+
+    Eigen::Vector3d position (const Image<float>& image) const
+    {
+      return { (image.index(0)+0.5) / dim[0], (image.index(1)+0.5) / dim[1], (image.index(2)+0.5) / dim[2] };
+    }
+
+    void operator() (Image<float>& dwi)
+    {
+      const Eigen::Vector3d u = position (dwi);
+      const uint64_t voxel = dwi.index(0) + dim[0] * (dwi.index(1) + dim[1] * dwi.index(2));
+      const bool in_phantom = inside (u);
+      const auto dirs = fibres (u);
+      const double fibre_fraction = dirs.size() ? (1.0 - ISOTROPIC_FRACTION) / dirs.size() : 0.0;
+      const double iso_fraction = dirs.size() ? ISOTROPIC_FRACTION : 1.0;
+
+      for (auto l = Loop (3) (dwi); l; ++l) {
+        const ssize_t n = dwi.index(3);
+        double signal = 0.0;
+        if (in_phantom) {
+          const double b = grad (n, 3);
+          signal = iso_fraction * std::exp (-b * ISOTROPIC_DIFFUSIVITY);
+          for (const auto& d : dirs)
+            signal += fibre_fraction * fibre_signal (grad.row(n).head<3>().dot (d), b);
+          signal *= S0;
+        }
+        if (noise) {
+          const uint64_t counter = 2 * (voxel * grad.rows() + n);
+          signal = std::sqrt (Math::pow2 (signal + noise * S0 * gaussian (counter)) + Math::pow2 (noise * S0 * gaussian (counter+1)));
+        }
+        dwi.value() = signal;
+      }
+    }
+
+  private:
+    const Eigen::MatrixXd& grad;
+    const double noise;
+    const size_t dim[3];
+};
+
+
+
+
+void run ()
+{
+  vector<int> size = argument[0];
+  if (size.size() != 3)
+    throw Exception ("phantom dimensions must be specified as 3 comma-separated integers");
+
+  const size_t num_directions = get_option_value ("directions", DEFAULT_NUM_DIRECTIONS);
+  const double bvalue = get_option_value ("bvalue", DEFAULT_BVALUE);
+  const double noise = get_option_value ("noise", DEFAULT_NOISE);
+  const auto grad = gen_scheme (num_directions, bvalue);
+
+  Header header;
+  header.ndim() = 4;
+  for (size_t n = 0; n < 3; ++n) {
+    header.size(n) = size[n];
+    header.spacing(n) = 2.0;
+  }
+  header.size(3) = grad.rows();
+  header.spacing(3) = 1.0;
+  header.transform().setIdentity();
+  header.datatype() = DataType::Float32;
+  header.datatype().set_byte_order_native();
+  Stride::set (header, Stride::contiguous_along_axis (3, header));
+  DWI::set_DW_scheme (header, grad);
+
+  Phantom phantom (header, grad, noise);
+
+  auto dwi = Image<float>::create (argument[1], header);
+  ThreadedLoop ("generating phantom data", dwi, 0, 3).run (phantom, dwi);
+
+  auto opt = get_options ("mask");
+  if (opt.size()) {
+    Header mask_header (header);
+    mask_header.ndim() = 3;
+    mask_header.datatype() = DataType::Bit;
+    DWI::clear_DW_scheme (mask_header);
+    auto mask = Image<bool>::create (opt[0][0], mask_header);
+    for (auto l = Loop (mask) (mask); l; ++l)
+      mask.value() = phantom.inside ({ (mask.index(0)+0.5) / size[0], (mask.index(1)+0.5) / size[1], (mask.index(2)+0.5) / size[2] });
+  }
+
+  opt = get_options ("response");
+  if (opt.size()) {
+    // zonal SH coefficients of the single-fibre response, by numerical
+    // integration over the cosine of the angle to the fibre axis:
+    const int lmax = 8;
+    const size_t num_steps = 1000;
+    Eigen::VectorXd response = Eigen::VectorXd::Zero (lmax/2 + 1);
+    for (size_t n = 0; n < num_steps; ++n) {
+      const double x = -1.0 + (n + 0.5) * 2.0 / num_steps;
+      const double signal = S0 * fibre_signal (x, bvalue);
+      for (int l = 0; l <= lmax; l += 2)
+        response[l/2] += signal * Math::Legendre::Plm_sph (l, 0, x);
+    }
+    response *= 2.0 * Math::pi * 2.0 / num_steps;
+    File::OFStream out (opt[0][0]);
+    out << response.transpose() << "\n";
+  }
+}
+
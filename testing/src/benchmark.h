@@ -0,0 +1,80 @@
+/*
+ * Copyright (c) 2008-2018 the MRtrix3 contributors.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at http://mozilla.org/MPL/2.0/
+ *
+ * MRtrix3 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * For more details, see http://www.mrtrix.org/
+ */
+
+
+#ifndef __testing_benchmark_h__
+#define __testing_benchmark_h__
+
+#include "app.h"
+#include "mrtrix.h"
+#include "timer.h"
+
+#define DEFAULT_BENCHMARK_MIN_TIME 0.5
+
+namespace MR
+{
+  namespace Testing
+  {
+
+
+    const App::OptionGroup Benchmark_Options =
+      App::OptionGroup ("Benchmark options")
+      + App::Option ("time", "the minimum time in seconds over which to measure each operation (default: " + str(DEFAULT_BENCHMARK_MIN_TIME) + ").")
+        + App::Argument ("seconds").type_float (0.0);
+
+
+
+    //! prevent the compiler from optimising away the computation of \a value
+    template <typename ValueType>
+      FORCE_INLINE void do_not_optimise (const ValueType& value)
+      {
+#if defined(__GNUC__) || defined(__clang__)
+        asm volatile ("" : : "g" (&value) : "memory");
+#else
+        static volatile const void* sink;
+        sink = &value;
+#endif
+      }
+
+
+
+    //! measure the mean time taken per operation, in nanoseconds
+    /*! \a func is invoked repeatedly (after one untimed invocation to warm
+     * up caches, etc.) until the minimum time specified via the -time option
+     * has elapsed; each invocation is taken to perform \a ops_per_call
+     * operations. The result is printed to standard output, labelled by \a
+     * name, and returned. */
+    template <class Functor>
+      double benchmark (const std::string& name, Functor&& func, size_t ops_per_call = 1)
+      {
+        const double min_time = App::get_option_value ("time", DEFAULT_BENCHMARK_MIN_TIME);
+        func();
+        size_t calls = 0;
+        Timer timer;
+        double elapsed;
+        do {
+          func();
+          ++calls;
+        } while ((elapsed = timer.elapsed()) < min_time);
+        const double ns_per_op = 1.0e9 * elapsed / (calls * ops_per_call);
+        std::cout << name << ": " << str (ns_per_op, 4) << " ns/op" << std::endl;
+        return ns_per_op;
+      }
+
+
+  }
+}
+
+#endif
+